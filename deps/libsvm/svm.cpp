@@ -37,6 +37,10 @@ static inline double powi(double base, int times)
 #define INF HUGE_VAL
 #define TAU 1e-12
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+// the dot products of one block of SVs and one block of queries of
+// svm_predict_batch take 16 KB, so they stay in the L1 cache
+#define BATCH_SV_BLOCK 64
+#define BATCH_QUERY_BLOCK 32
 
 static void print_string_stdout(const char *s)
 {
@@ -206,6 +210,7 @@ public:
 
 	static double k_function(const svm_node *x, const svm_node *y,
 				 const svm_parameter& param);
+	static double dot(const svm_node *px, const svm_node *py);
 	virtual Qfloat *get_Q(int column, int len) const = 0;
 	virtual double *get_QD() const = 0;
 	virtual void swap_index(int i, int j) const	// no so const...
@@ -227,7 +232,6 @@ private:
 	const double gamma;
 	const double coef0;
 
-	static double dot(const svm_node *px, const svm_node *py);
 	double kernel_linear(int i, int j) const
 	{
 		return dot(x[i],x[j]);
@@ -2086,6 +2090,30 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 	free(data_label);
 }
 
+// squared norm of each SV; computed once, so the RBF kernel of a
+// prediction only multiplies the matching features. Left NULL if it
+// can't be allocated; the kernel then computes the norms itself
+static void svm_set_sv_square(svm_model *model)
+{
+	model->sv_square = Malloc(double,model->l);
+	if(model->sv_square == NULL)
+		return;
+	for(int i=0;i<model->l;i++)
+		model->sv_square[i] = Kernel::dot(model->SV[i],model->SV[i]);
+}
+
+// single kernel evaluation of the query X with squared norm X_SQUARE and
+// the I-th SV of MODEL
+static inline double svm_k_function(const svm_model *model, const svm_node *x, double x_square, int i)
+{
+	if(model->param.kernel_type == RBF && model->sv_square)
+	{
+		double d = x_square+model->sv_square[i]-2*Kernel::dot(x,model->SV[i]);
+		return exp(-model->param.gamma*(d > 0 ? d : 0));
+	}
+	return Kernel::k_function(x,model->SV[i],model->param);
+}
+
 //
 // Interface functions
 //
@@ -2094,6 +2122,7 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 	svm_model *model = Malloc(svm_model,1);
 	model->param = *param;
 	model->free_sv = 0;	// XXX
+	model->sv_square = NULL;
 
 	if(param->svm_type == ONE_CLASS ||
 	   param->svm_type == EPSILON_SVR ||
@@ -2332,6 +2361,7 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 		free(nz_count);
 		free(nz_start);
 	}
+	svm_set_sv_square(model);
 	return model;
 }
 
@@ -2498,7 +2528,10 @@ double svm_get_svr_probability(const svm_model *model)
 	}
 }
 
-double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+// predict with the caller's buffers; kvalue, start and vote are only used
+// by the classifiers, so nothing is allocated here
+static double svm_predict_values_with(const svm_model *model, const svm_node *x, double* dec_values,
+	double *kvalue, int *start, int *vote)
 {
 	int i;
 	if(model->param.svm_type == ONE_CLASS ||
@@ -2506,9 +2539,10 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 	   model->param.svm_type == NU_SVR)
 	{
 		double *sv_coef = model->sv_coef[0];
+		double x_square = Kernel::dot(x,x);
 		double sum = 0;
 		for(i=0;i<model->l;i++)
-			sum += sv_coef[i] * Kernel::k_function(x,model->SV[i],model->param);
+			sum += sv_coef[i] * svm_k_function(model,x,x_square,i);
 		sum -= model->rho[0];
 		*dec_values = sum;
 
@@ -2522,16 +2556,14 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 		int nr_class = model->nr_class;
 		int l = model->l;
 		
-		double *kvalue = Malloc(double,l);
+		double x_square = Kernel::dot(x,x);
 		for(i=0;i<l;i++)
-			kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
+			kvalue[i] = svm_k_function(model,x,x_square,i);
 
-		int *start = Malloc(int,nr_class);
 		start[0] = 0;
 		for(i=1;i<nr_class;i++)
 			start[i] = start[i-1]+model->nSV[i-1];
 
-		int *vote = Malloc(int,nr_class);
 		for(i=0;i<nr_class;i++)
 			vote[i] = 0;
 
@@ -2567,23 +2599,239 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 			if(vote[i] > vote[vote_max_idx])
 				vote_max_idx = i;
 
-		free(kvalue);
-		free(start);
-		free(vote);
 		return model->label[vote_max_idx];
 	}
 }
 
+double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+{
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+		return svm_predict_values_with(model, x, dec_values, NULL, NULL, NULL);
+
+	double *kvalue = Malloc(double,model->l);
+	int *start = Malloc(int,model->nr_class);
+	int *vote = Malloc(int,model->nr_class);
+	double pred_result = svm_predict_values_with(model, x, dec_values, kvalue, start, vote);
+	free(kvalue);
+	free(start);
+	free(vote);
+	return pred_result;
+}
+
+svm_scratch *svm_scratch_create(const svm_model *model)
+{
+	svm_scratch *scratch = Malloc(svm_scratch,1);
+	if(scratch == NULL)
+		return NULL;
+	int nr_class = model->nr_class;
+	scratch->l = model->l;
+	scratch->nr_class = nr_class;
+	scratch->dec_values = Malloc(double,max(nr_class*(nr_class-1)/2,1));
+	scratch->kvalue = Malloc(double,max(model->l,1));
+	scratch->start = Malloc(int,max(nr_class,1));
+	scratch->vote = Malloc(int,max(nr_class,1));
+	if(scratch->dec_values == NULL || scratch->kvalue == NULL ||
+	   scratch->start == NULL || scratch->vote == NULL)
+	{
+		svm_scratch_free(scratch);
+		return NULL;
+	}
+	return scratch;
+}
+
+void svm_scratch_free(svm_scratch *scratch)
+{
+	if(scratch == NULL)
+		return;
+	free(scratch->dec_values);
+	free(scratch->kvalue);
+	free(scratch->start);
+	free(scratch->vote);
+	free(scratch);
+}
+
+// reentrant svm_predict: the model is only read and all the buffers are in
+// scratch, so many threads can predict at once with a scratch each. The
+// decision value (the first pairwise one for the classifiers) is saved to
+// decision; all of them are in scratch->dec_values
+double svm_predict_into(const svm_model *model, const svm_node *x, svm_scratch *scratch, double *decision)
+{
+	double pred_result = svm_predict_values_with(model, x, scratch->dec_values,
+		scratch->kvalue, scratch->start, scratch->vote);
+	if(decision)
+		*decision = scratch->dec_values[0];
+	return pred_result;
+}
+
+// kernel value from the dot product of the query and one SV, and their
+// squared norms
+static inline double svm_k_from_dot(const svm_parameter& param, double dot, double x_square, double sv_square)
+{
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return dot;
+		case POLY:
+			return powi(param.gamma*dot+param.coef0,param.degree);
+		case RBF:
+		{
+			double d = x_square+sv_square-2*dot;
+			return exp(-param.gamma*(d > 0 ? d : 0));
+		}
+		case SIGMOID:
+			return tanh(param.gamma*dot+param.coef0);
+		default:
+			return 0;
+	}
+}
+
+// a value of one query of the current query block in the list of its
+// feature index
+struct batch_entry
+{
+	int q;
+	double value;
+	int next;
+};
+
+// predict the n queries xs to out like svm_predict. For one-class and
+// regression models the queries are scored in blocks against blocks of
+// SVs: the features of a query block are inverted into lists by index and
+// the dot products of a SV block with the whole query block are summed
+// over them, so each SV block is read once per query block instead of
+// once per query. The other models are predicted one query at a time.
+// Returns 0, or -1 if the buffers can't be allocated
+int svm_predict_batch(const svm_model *model, svm_node **xs, int n, double *out)
+{
+	int i, q;
+	const svm_parameter& param = model->param;
+	if(!(param.svm_type == ONE_CLASS || param.svm_type == EPSILON_SVR || param.svm_type == NU_SVR) ||
+	   param.kernel_type == PRECOMPUTED)
+	{
+		svm_scratch *scratch = svm_scratch_create(model);
+		if(scratch == NULL)
+			return -1;
+		for(q=0;q<n;q++)
+			out[q] = svm_predict_into(model, xs[q], scratch, NULL);
+		svm_scratch_free(scratch);
+		return 0;
+	}
+
+	int l = model->l;
+	double *sv_coef = model->sv_coef[0];
+	int dim = 1;
+	for(i=0;i<l;i++)
+		for(const svm_node *node = model->SV[i]; node->index != -1; node++)
+			dim = max(dim, node->index+1);
+
+	int max_entries = 0;
+	for(q=0;q<n;q++)
+		for(const svm_node *node = xs[q]; node->index != -1; node++)
+			max_entries++;
+
+	int *head = Malloc(int,dim);
+	double *dots = Malloc(double,BATCH_SV_BLOCK*BATCH_QUERY_BLOCK);
+	double *x_square = Malloc(double,BATCH_QUERY_BLOCK);
+	double *sum = Malloc(double,BATCH_QUERY_BLOCK);
+	batch_entry *entries = Malloc(batch_entry,max(max_entries,1));
+	if(head == NULL || dots == NULL || x_square == NULL || sum == NULL || entries == NULL)
+	{
+		free(head);
+		free(dots);
+		free(x_square);
+		free(sum);
+		free(entries);
+		return -1;
+	}
+	for(i=0;i<dim;i++)
+		head[i] = -1;
+
+	for(int q0=0;q0<n;q0+=BATCH_QUERY_BLOCK)
+	{
+		int nq = min(BATCH_QUERY_BLOCK, n-q0);
+
+		// invert the query block
+		int nentries = 0;
+		for(q=0;q<nq;q++)
+		{
+			x_square[q] = Kernel::dot(xs[q0+q],xs[q0+q]);
+			sum[q] = 0;
+			for(const svm_node *node = xs[q0+q]; node->index != -1; node++)
+			{
+				if(node->index < 0 || node->index >= dim)
+					continue;
+				batch_entry *e = &entries[nentries];
+				e->q = q;
+				e->value = node->value;
+				e->next = head[node->index];
+				head[node->index] = nentries++;
+			}
+		}
+
+		for(int s0=0;s0<l;s0+=BATCH_SV_BLOCK)
+		{
+			int ns = min(BATCH_SV_BLOCK, l-s0);
+
+			// dots[i*nq+q] is the dot product of SV s0+i and query q0+q
+			memset(dots, 0, ns*nq*sizeof(double));
+			for(i=0;i<ns;i++)
+			{
+				double *row = dots+i*nq;
+				for(const svm_node *node = model->SV[s0+i]; node->index != -1; node++)
+				{
+					if(node->index < 0)
+						continue;
+					for(int k = head[node->index]; k != -1; k = entries[k].next)
+						row[entries[k].q] += node->value*entries[k].value;
+				}
+			}
+
+			for(i=0;i<ns;i++)
+			{
+				double sv_square = 0;
+				if(param.kernel_type == RBF)
+					sv_square = model->sv_square ? model->sv_square[s0+i] : Kernel::dot(model->SV[s0+i],model->SV[s0+i]);
+				double coef = sv_coef[s0+i];
+				const double *row = dots+i*nq;
+				for(q=0;q<nq;q++)
+					sum[q] += coef*svm_k_from_dot(param, row[q], x_square[q], sv_square);
+			}
+		}
+
+		for(q=0;q<nq;q++)
+		{
+			double dec_value = sum[q]-model->rho[0];
+			out[q0+q] = (param.svm_type == ONE_CLASS) ? (dec_value>0 ? 1 : -1) : dec_value;
+		}
+
+		// reset the lists for the next query block
+		for(q=0;q<nq;q++)
+			for(const svm_node *node = xs[q0+q]; node->index != -1; node++)
+				if(node->index >= 0 && node->index < dim)
+					head[node->index] = -1;
+	}
+
+	free(head);
+	free(dots);
+	free(x_square);
+	free(sum);
+	free(entries);
+	return 0;
+}
+
 double svm_predict(const svm_model *model, const svm_node *x)
 {
 	int nr_class = model->nr_class;
-	double *dec_values;
 	if(model->param.svm_type == ONE_CLASS ||
 	   model->param.svm_type == EPSILON_SVR ||
 	   model->param.svm_type == NU_SVR)
-		dec_values = Malloc(double, 1);
-	else 
-		dec_values = Malloc(double, nr_class*(nr_class-1)/2);
+	{
+		double dec_value;
+		return svm_predict_values(model, x, &dec_value);
+	}
+	double *dec_values = Malloc(double, nr_class*(nr_class-1)/2);
 	double pred_result = svm_predict_values(model, x, dec_values);
 	free(dec_values);
 	return pred_result;
@@ -2887,6 +3135,7 @@ svm_model *svm_load_model(const char *model_file_name)
 	model->sv_indices = NULL;
 	model->label = NULL;
 	model->nSV = NULL;
+	model->sv_square = NULL;
 	
 	// read header
 	if (!read_model_header(fp, model))
@@ -2972,6 +3221,7 @@ svm_model *svm_load_model(const char *model_file_name)
 		return NULL;
 
 	model->free_sv = 1;	// XXX
+	svm_set_sv_square(model);
 	return model;
 }
 
@@ -3008,6 +3258,9 @@ void svm_free_model_content(svm_model* model_ptr)
 
 	free(model_ptr->nSV);
 	model_ptr->nSV = NULL;
+
+	free(model_ptr->sv_square);
+	model_ptr->sv_square = NULL;
 }
 
 void svm_free_and_destroy_model(svm_model** model_ptr_ptr)
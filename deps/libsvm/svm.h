@@ -69,6 +69,19 @@ struct svm_model
 	/* XXX */
 	int free_sv;		/* 1 if svm_model is created by svm_load_model*/
 				/* 0 if svm_model is created by svm_train */
+	double *sv_square;	/* squared norm of each SV (sv_square[l]); set by svm_train and svm_load_model; NULL if it couldn't be allocated */
+};
+
+/* scratch space of svm_predict_into; sized once for one model and used by
+   one thread at a time, so the prediction never allocates */
+struct svm_scratch
+{
+	int l;			/* total #SV of the model */
+	int nr_class;		/* number of classes of the model */
+	double *dec_values;	/* decision values (dec_values[k*(k-1)/2]) */
+	double *kvalue;		/* kernel value of each SV (kvalue[l]) */
+	int *start;		/* first SV of each class (start[k]) */
+	int *vote;		/* votes of each class (vote[k]) */
 };
 
 struct svm_model *svm_train(const struct svm_problem *prob, const struct svm_parameter *param);
@@ -87,6 +100,10 @@ double svm_get_svr_probability(const struct svm_model *model);
 double svm_predict_values(const struct svm_model *model, const struct svm_node *x, double* dec_values);
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
+struct svm_scratch *svm_scratch_create(const struct svm_model *model);
+void svm_scratch_free(struct svm_scratch *scratch);
+double svm_predict_into(const struct svm_model *model, const struct svm_node *x, struct svm_scratch *scratch, double *decision);
+int svm_predict_batch(const struct svm_model *model, struct svm_node **xs, int n, double *out);
 
 void svm_free_model_content(struct svm_model *model_ptr);
 void svm_free_and_destroy_model(struct svm_model **model_ptr_ptr);
@@ -0,0 +1,141 @@
+/* Sayoeti Arena
+ * Append-only memory arena and fixed size slab pool. Indexing a corpus
+ * creates millions of small objects (terms and dictionary items) that live
+ * as long as their dictionary. Instead of malloc'ing each of them, we carve
+ * them from big chunks and free the chunks at once; they are never freed
+ * one by one.
+ *
+ * Chunks never move, so a pointer returned by the arena stays valid until
+ * the arena is destroyed.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* Every object carved by arena_alloc is aligned to this size */
+#define ARENA_ALIGN sizeof(double)
+
+/* arena_new: initializes new arena with chunk of CHUNK_SIZE bytes */
+struct arena *arena_new(size_t chunk_size)
+{
+    struct arena *a = (struct arena *)malloc(sizeof(struct arena));
+    if(a == NULL) {
+        return NULL;
+    }
+
+    a->chunk_size = chunk_size;
+    a->head = NULL;
+    return a;
+}
+
+/* arena_bump: carve SIZE bytes aligned to ALIGN from arena A. It allocates
+ * new chunk if the current one is full. Returns NULL if we can't allocate
+ * the new chunk. */
+static void *arena_bump(struct arena *a, size_t size, size_t align)
+{
+    struct arena_chunk *c = a->head;
+    size_t start = 0;
+    if(c != NULL) {
+        start = (c->used + align - 1) & ~(align - 1);
+    }
+
+    /* The current chunk is full, create new one. Objects bigger than the
+     * chunk size get their own chunk */
+    if(c == NULL || start + size > c->size) {
+        size_t csize = (size > a->chunk_size) ? size : a->chunk_size;
+        c = (struct arena_chunk *)malloc(sizeof(struct arena_chunk) + csize);
+        if(c == NULL) {
+            return NULL;
+        }
+        c->size = csize;
+        c->used = 0;
+        c->next = a->head;
+        a->head = c;
+        start = 0;
+    }
+
+    c->used = start + size;
+    return c->data + start;
+}
+
+/* arena_alloc: allocates SIZE bytes from arena A */
+void *arena_alloc(struct arena *a, size_t size)
+{
+    return arena_bump(a, size, ARENA_ALIGN);
+}
+
+/* arena_strdup: copy the string S to arena A. Strings are packed without
+ * alignment. */
+char *arena_strdup(struct arena *a, char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *t = (char *)arena_bump(a, len, 1);
+    if(t == NULL) {
+        return NULL;
+    }
+    memcpy(t, s, len);
+    return t;
+}
+
+/* arena_destroy: free all chunks of arena A */
+void arena_destroy(struct arena *a)
+{
+    if(a == NULL) return;
+
+    struct arena_chunk *c = a->head;
+    while(c != NULL) {
+        struct arena_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(a);
+}
+
+/* pool_new: initializes new pool of objects with size ITEM_SIZE. Each slab
+ * holds NITEMS_PER_SLAB objects. */
+struct pool *pool_new(size_t item_size, long nitems_per_slab)
+{
+    struct pool *p = (struct pool *)malloc(sizeof(struct pool));
+    if(p == NULL) {
+        return NULL;
+    }
+
+    item_size = (item_size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    p->arena = arena_new(item_size * nitems_per_slab);
+    if(p->arena == NULL) {
+        free(p);
+        return NULL;
+    }
+    p->item_size = item_size;
+    return p;
+}
+
+/* pool_alloc: get one object from pool P */
+void *pool_alloc(struct pool *p)
+{
+    return arena_alloc(p->arena, p->item_size);
+}
+
+/* pool_destroy: free all slabs of pool P */
+void pool_destroy(struct pool *p)
+{
+    if(p == NULL) return;
+    arena_destroy(p->arena);
+    free(p);
+}
@@ -0,0 +1,70 @@
+/* Sayoeti Arena
+ * Append-only memory arena and fixed size slab pool. Indexing a corpus
+ * creates millions of small objects (terms and dictionary items) that live
+ * as long as their dictionary. Instead of malloc'ing each of them, we carve
+ * them from big chunks and free the chunks at once; they are never freed
+ * one by one.
+ *
+ * Chunks never move, so a pointer returned by the arena stays valid until
+ * the arena is destroyed.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* arena_chunk: one big memory chunk of the arena */
+struct arena_chunk {
+    struct arena_chunk *next;
+
+    /* Number of bytes available and used in DATA */
+    size_t size;
+    size_t used;
+
+    char data[];
+};
+
+/* arena: represents the append-only memory arena */
+struct arena {
+    /* Default size of each chunk */
+    size_t chunk_size;
+
+    /* The current chunk; older chunks are linked from it */
+    struct arena_chunk *head;
+};
+
+/* pool: represents the slab pool of objects with the same size; the
+ * slabs are carved from the arena */
+struct pool {
+    struct arena *arena;
+
+    /* The size of each object */
+    size_t item_size;
+};
+
+/* Prototypes */
+struct arena *arena_new(size_t chunk_size);
+void *arena_alloc(struct arena *a, size_t size);
+char *arena_strdup(struct arena *a, char *s);
+void arena_destroy(struct arena *a);
+
+struct pool *pool_new(size_t item_size, long nitems_per_slab);
+void *pool_alloc(struct pool *p);
+void pool_destroy(struct pool *p);
+
+#endif
@@ -0,0 +1,99 @@
+/* Sayoeti Bloom Filter
+ * Blocked Bloom filter to reject the terms that are not in the dictionary
+ * before we probe the tree or the hash table. Every term sets its bits in
+ * one 512-bit block, so a check touches exactly one cache line. The terms
+ * are hashed by vocab_hash.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "bloom.h"
+
+/* bloom_nblocks: get the number of blocks for NITEMS terms */
+long bloom_nblocks(long nitems)
+{
+    long nbits = nitems * BLOOM_BITS_PER_ITEM;
+    return nbits / (BLOOM_BLOCK_WORDS * 64) + 1;
+}
+
+/* bloom_block: get the block of the hash H in filter B */
+static uint64_t *bloom_block(struct bloom *b, uint64_t h)
+{
+    uint64_t bi = ((h >> 32) * (uint64_t)b->nblocks) >> 32;
+    return b->bits + bi * BLOOM_BLOCK_WORDS;
+}
+
+/* bloom_new: initializes new filter for NITEMS terms. Returns NULL if only
+ * if error happen and ERRNO will be set to last error. */
+struct bloom *bloom_new(long nitems)
+{
+    struct bloom *b = (struct bloom *)malloc(sizeof(struct bloom));
+    if(b == NULL) {
+        return NULL;
+    }
+
+    b->nblocks = bloom_nblocks(nitems);
+    b->capacity = nitems;
+
+    /* Align each block to the cache line */
+    size_t size = b->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+    if(posix_memalign((void **)&b->bits, 64, size) != 0) {
+        free(b);
+        return NULL;
+    }
+    memset(b->bits, 0, size);
+
+    return b;
+}
+
+/* bloom_add: add the hash H of a term to filter B */
+void bloom_add(struct bloom *b, uint64_t h)
+{
+    uint64_t *block = bloom_block(b, h);
+    uint64_t g = h * 0x9e3779b97f4a7c15ULL;
+
+    int i;
+    for(i = 0; i < BLOOM_NPROBES; i++) {
+        unsigned int bit = (g >> (i * 9)) & 511;
+        block[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+/* bloom_check: check wether the hash H of a term may be in filter B. It
+ * returns FALSE if the term is definitely not in B */
+int bloom_check(struct bloom *b, uint64_t h)
+{
+    uint64_t *block = bloom_block(b, h);
+    uint64_t g = h * 0x9e3779b97f4a7c15ULL;
+
+    /* Check all probes without branching on each of them */
+    uint64_t ok = 1;
+    int i;
+    for(i = 0; i < BLOOM_NPROBES; i++) {
+        unsigned int bit = (g >> (i * 9)) & 511;
+        ok &= block[bit >> 6] >> (bit & 63);
+    }
+    return (int)(ok & 1);
+}
+
+/* bloom_destroy: remove filter B from memory */
+void bloom_destroy(struct bloom *b)
+{
+    if(b == NULL) return;
+    free(b->bits);
+    free(b);
+}
@@ -0,0 +1,54 @@
+/* Sayoeti Bloom Filter
+ * Blocked Bloom filter to reject the terms that are not in the dictionary
+ * before we probe the tree or the hash table. Every term sets its bits in
+ * one 512-bit block, so a check touches exactly one cache line. The terms
+ * are hashed by vocab_hash.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdint.h>
+
+/* Macros */
+/* Number of bits for each term; gives ~1% false positive rate */
+#define BLOOM_BITS_PER_ITEM 10
+/* Number of bits set by each term in its block */
+#define BLOOM_NPROBES 6
+/* Number of 64-bit words in one block; one cache line */
+#define BLOOM_BLOCK_WORDS 8
+
+/* bloom: represents the blocked Bloom filter */
+struct bloom {
+    /* Number of blocks */
+    long nblocks;
+
+    /* Number of terms the filter is sized for */
+    long capacity;
+
+    /* The bits; NBLOCKS * BLOOM_BLOCK_WORDS words */
+    uint64_t *bits;
+};
+
+/* Prototypes */
+long bloom_nblocks(long nitems);
+struct bloom *bloom_new(long nitems);
+void bloom_add(struct bloom *b, uint64_t h);
+int bloom_check(struct bloom *b, uint64_t h);
+void bloom_destroy(struct bloom *b);
+
+#endif
@@ -2,9 +2,15 @@
  * Collection of common function to manage the corpus of sayoeti.
  * - Create index vocabulary from corpus
  * - Create vector representation sparse vector of document using
- *   TF(term frequency) 
+ *   TF(term frequency); the frequencies are counted in a reusable hash
+ *   table and sorted by term id into a contiguous array of svm_node
  * - Compute IDF(Inverse document frequency) for each term in 
  *   Index vocabulary
+ * - Renumber the terms by document frequency, so the common terms have
+ *   the smallest ids
+ * - Prune the rare and the too common terms
+ * - Or skip the index vocabulary; hash each term to its id
+ * - Add the hashed word n-grams of the id stream next to the terms
  *
  * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
  * 
@@ -25,198 +31,180 @@
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
+#include <stdint.h>
 
 #include "dict.h"
+#include "vocab.h"
 #include "corpus.h"
 #include "utils.h"
+#include "stemmer.h"
 
-/* corpus_doc_item_new: initializes new corpus document item */
-struct corpus_doc_item *corpus_doc_item_new(long index, char *term)
+/* corpus_tf_new: initializes new term frequency table with 2^BITS slots.
+ * The table grows when it's half full. */
+struct corpus_tf *corpus_tf_new(int bits)
 {
-    /* Allocate memory for current document item */
-    struct corpus_doc_item *cdoci = (struct corpus_doc_item *)malloc(sizeof(struct corpus_doc_item));
-    if(cdoci == NULL) {
+    struct corpus_tf *tf = (struct corpus_tf *)malloc(sizeof(struct corpus_tf));
+    if(tf == NULL) {
         return NULL;
     }
-    
-    /* Save the term to a t variable, to avoid deletion of index vocabulary term */
-    char *t = (char *)malloc(sizeof(char) * (strlen(term) + 1));
-    if(t == NULL) {
+
+    tf->bits = bits;
+    tf->size = 1L << bits;
+    tf->nused = 0;
+    tf->ngrams = 1;
+    tf->ngrambits = 0;
+    tf->ngrambase = 0;
+    tf->nhistory = 0;
+    tf->keys = (int *)calloc(tf->size, sizeof(int));
+    tf->counts = (int *)calloc(tf->size, sizeof(int));
+    tf->used = (long *)malloc(tf->size / 2 * sizeof(long));
+    if(tf->keys == NULL || tf->counts == NULL || tf->used == NULL) {
+        corpus_tf_destroy(tf);
         return NULL;
     }
 
-    /* Copy TERM to T */
-    strcpy(t, term);
-
-    /* Set initials value */
-    cdoci->index = index;
-    cdoci->term = t;
-    cdoci->frequency = 1;
-    cdoci->is_inserted = FALSE;
-    cdoci->height = 1;
-    cdoci->left = NULL;
-    cdoci->right = NULL;
-
-    return cdoci;
+    return tf;
 }
 
-/* corpus_doc_item_destroy: free all allocated memory for document item 
- * CDOCI */
-void corpus_doc_item_destroy(struct corpus_doc_item *cdoci)
+/* corpus_tf_slot: get the slot of term index INDEX in table TF; either the
+ * slot of INDEX or the empty slot where it should be placed */
+static long corpus_tf_slot(struct corpus_tf *tf, long index)
 {
-    if(cdoci == NULL) {
-        return;
+    long mask = tf->size - 1;
+    long slot = (long)(((uint32_t)index * 2654435761u) >> (32 - tf->bits));
+    while(tf->keys[slot] != 0 && tf->keys[slot] != index) {
+        slot = (slot + 1) & mask;
     }
-
-    free(cdoci->term);
-    free(cdoci);
+    return slot;
 }
 
-/* corpus_doc_item_height: get the height of corpus document item ITEM */
-int corpus_doc_item_height(struct corpus_doc_item *item)
+/* corpus_tf_grow: double the size of table TF. It returns -1 if we can't
+ * allocate the memory */
+static int corpus_tf_grow(struct corpus_tf *tf)
 {
-    if(item == NULL) {
-        return 0;
+    struct corpus_tf *big = corpus_tf_new(tf->bits + 1);
+    if(big == NULL) {
+        return -1;
     }
-    return item->height;
-}
 
-/* corpus_doc_item_get_balance: get the balance factor of corpus document 
- * item ITEM */
-int corpus_doc_item_get_balance(struct corpus_doc_item *item)
-{
-    if(item == NULL) {
-        return 0;
+    /* Move the counts in the same order */
+    long ui;
+    for(ui = 0; ui < tf->nused; ui++) {
+        long old = tf->used[ui];
+        long slot = corpus_tf_slot(big, tf->keys[old]);
+        big->keys[slot] = tf->keys[old];
+        big->counts[slot] = tf->counts[old];
+        big->used[big->nused++] = slot;
     }
-    return corpus_doc_item_height(item->left) - corpus_doc_item_height(item->right);
-}
-
-/* corpus_doc_item_rotate_right: Performs AVL tree right rotation on 
- * document item ITEM. It returns right rotated document item. */
-struct corpus_doc_item *corpus_doc_item_rotate_right(struct corpus_doc_item *item)
-{
-    struct corpus_doc_item *backup_left = item->left;
-    struct corpus_doc_item *backup_right = backup_left->right;
-
-    /* Perform rotation */
-    backup_left->right = item;
-    item->left = backup_right;
-
-    /* Update the heights */
-    int hil = corpus_doc_item_height(item->left);
-    int hir = corpus_doc_item_height(item->right);
-    item->height = util_max(hil, hir) + 1;
-
-    int bll = corpus_doc_item_height(backup_left->left);
-    int blr = corpus_doc_item_height(backup_left->right);
-    backup_left->height = util_max(bll, blr) + 1;
 
-    /* Return rotated item */
-    return backup_left;
+    /* Swap the slots; the n-gram state stays */
+    free(tf->keys);
+    free(tf->counts);
+    free(tf->used);
+    tf->bits = big->bits;
+    tf->size = big->size;
+    tf->keys = big->keys;
+    tf->counts = big->counts;
+    tf->used = big->used;
+    tf->nused = big->nused;
+    free(big);
+    return 0;
 }
 
-/* corpus_doc_item_rotate_left: Performs AVL tree right rotation on 
- * document item ITEM. It returns right rotated document item. */
-struct corpus_doc_item *corpus_doc_item_rotate_left(struct corpus_doc_item *item)
+/* corpus_tf_ngrams: count the word n-grams up to NGRAMS words in table TF
+ * too; each n-gram is hashed to one of 2^NGRAMBITS ids after the id
+ * NGRAMBASE. NGRAMS is 1 to count only the terms */
+void corpus_tf_ngrams(struct corpus_tf *tf, int ngrams, int ngrambits, long ngrambase)
 {
-    struct corpus_doc_item *backup_right = item->right;
-    struct corpus_doc_item *backup_left = backup_right->left;
-
-    /* Perform rotation */
-    backup_right->left = item;
-    item->right = backup_left;
-
-    /* Update the heights */
-    int hil = corpus_doc_item_height(item->left);
-    int hir = corpus_doc_item_height(item->right);
-    item->height = util_max(hil, hir) + 1;
-
-    int brl = corpus_doc_item_height(backup_right->left);
-    int brr = corpus_doc_item_height(backup_right->right);
-    backup_right->height = util_max(brl, brr) + 1;
-
-    /* Return rotated item */
-    return backup_right;
+    tf->ngrams = ngrams;
+    tf->ngrambits = ngrambits;
+    tf->ngrambase = ngrambase;
+    tf->nhistory = 0;
 }
 
-/* corpus_doc_item_insert: insert new document item to the document root ROOT;
- * increase the frequency if the ITEM is already exists in ROOT */
-struct corpus_doc_item *corpus_doc_item_insert(struct corpus_doc_item *root, struct corpus_doc_item *item) 
+/* corpus_tf_add: add COUNT occurrences of the term index INDEX to table TF;
+ * COUNT is negative for the hashed terms with negative sign. It returns -1
+ * if we can't allocate the memory */
+int corpus_tf_add(struct corpus_tf *tf, long index, int count)
 {
-    /* Set root for the first time or assign to root->left or root->right */
-    if(root == NULL) {
-        item->is_inserted = TRUE;
-        return item;
+    long slot = corpus_tf_slot(tf, index);
+    if(tf->keys[slot] == index) {
+        tf->counts[slot] += count;
+        return 0;
     }
 
-    /* Build Binary Search Tree based on item->index */
-    if(item->index == root->index) {
-        /* increase the frequency of the root */
-        root->frequency += 1;
-    }else if(item->index < root->index) {
-        root->left = corpus_doc_item_insert(root->left, item);
-    }else if(item->index > root->index) {
-        root->right = corpus_doc_item_insert(root->right, item);
+    /* New term; keep the table at most half full */
+    if(tf->nused + 1 > tf->size / 2) {
+        if(corpus_tf_grow(tf) != 0) {
+            return -1;
+        }
+        slot = corpus_tf_slot(tf, index);
     }
 
-    /* Update the height of the ancestor node */
-    int hrl = corpus_doc_item_height(root->left);
-    int hrr = corpus_doc_item_height(root->right);
-    root->height = util_max(hrl, hrr) + 1;
-    
-    /* Get the balance factor to check wether tree is balance or unbalanced */
-    int balance = corpus_doc_item_get_balance(root);
+    tf->keys[slot] = (int)index;
+    tf->counts[slot] = count;
+    tf->used[tf->nused++] = slot;
+    return 0;
+}
 
-    /* 4 case if the tree is unbalanced 
-     * Case 1: Left left case */
-    if(balance > 1 && (item->index < root->index)) {
-        /* Perform right rotation */
-        return corpus_doc_item_rotate_right(root);
+/* corpus_tf_push: add the next term index INDEX of the document with sign
+ * SIGN to table TF, then each n-gram that ends with it. The n-grams are
+ * built from the ids, so the terms are never joined as strings. It returns
+ * -1 if we can't allocate the memory */
+int corpus_tf_push(struct corpus_tf *tf, long index, int sign)
+{
+    if(corpus_tf_add(tf, index, sign) != 0) {
+        return -1;
     }
-
-    /* Case 2: Right right case */
-    if(balance < -1 && (item->index > root->index)) {
-        /* Perform left rotation */
-        return corpus_doc_item_rotate_left(root);
+    if(tf->ngrams < 2) {
+        return 0;
     }
 
-    /* Case 3: Right left case */
-    if(balance < -1 && (item->index < root->index)) {
-        root->right = corpus_doc_item_rotate_right(root->right);
-        return corpus_doc_item_rotate_left(root);
+    /* The n-gram of K words is the last K-1 ids and INDEX */
+    long ids[VOCAB_MAX_NGRAMS];
+    int nh = tf->nhistory;
+    memcpy(ids, tf->history, nh * sizeof(long));
+    ids[nh] = index;
+
+    int k;
+    for(k = 2; k <= tf->ngrams && k <= nh + 1; k++) {
+        int nsign;
+        long id = vocab_ngram_id(tf->ngrambase, tf->ngrambits, ids + nh + 1 - k, k, &nsign);
+        if(corpus_tf_add(tf, id, nsign) != 0) {
+            return -1;
+        }
     }
 
-    /* Case 4: Left right case */
-    if(balance > 1 && (item->index > root->index)) {
-        root->left = corpus_doc_item_rotate_left(root->left);
-        return corpus_doc_item_rotate_right(root);
+    /* Keep the last NGRAMS-1 ids */
+    if(nh == tf->ngrams - 1) {
+        memmove(tf->history, tf->history + 1, (nh - 1) * sizeof(long));
+        nh -= 1;
     }
-
-    return root;
+    tf->history[nh] = index;
+    tf->nhistory = nh + 1;
+    return 0;
 }
 
-/* corpus_doc_item_print: print the sparse vector representation of the corpus
- * document */
-void corpus_doc_item_print(struct corpus_doc_item *root)
+/* corpus_tf_reset: forget the counts and the n-gram history of table TF;
+ * only the occupied slots are cleared */
+void corpus_tf_reset(struct corpus_tf *tf)
 {
-    if(root == NULL) return;
-    if(root->left) corpus_doc_item_print(root->left);
-    printf("%li:%d:%s ", root->index, root->frequency, root->term);
-    if(root->right) corpus_doc_item_print(root->right);
+    long ui;
+    for(ui = 0; ui < tf->nused; ui++) {
+        tf->keys[tf->used[ui]] = 0;
+    }
+    tf->nused = 0;
+    tf->nhistory = 0;
 }
 
-/* corpus_doc_item_exists: check wether the INDEX of term is exists or not
- * in the document root ROOT. It returns positive integer is the INDEX is 
- * found, otherwise 0 will returned */
-int corpus_doc_item_exists(struct corpus_doc_item *root, long index)
+/* corpus_tf_destroy: remove table TF from memory */
+void corpus_tf_destroy(struct corpus_tf *tf)
 {
-    /* ITEM not exists in ROOT */
-    if(root == NULL) return 0;
-    if(index == root->index) return 1;
-    if(index < root->index) return corpus_doc_item_exists(root->left, index);
-    if(index > root->index) return corpus_doc_item_exists(root->right, index);
-
-    return 0;
+    if(tf == NULL) return;
+    free(tf->keys);
+    free(tf->counts);
+    free(tf->used);
+    free(tf);
 }
 
 /* corpus_doc_new: initialize new corpus document */
@@ -231,6 +219,7 @@ struct corpus_doc *corpus_doc_new(char *path)
      * to another memory address. This is fucking exciting */
     char *p = (char *)malloc(sizeof(char) * (strlen(path) + 1));
     if(p == NULL) {
+        free(cdoc);
         return NULL;
     }
 
@@ -239,14 +228,77 @@ struct corpus_doc *corpus_doc_new(char *path)
 
     cdoc->path = p;
     cdoc->nitems = 0;
-    cdoc->root = NULL;
+    cdoc->nodes = NULL;
 
     return cdoc;
 }
 
+/* corpus_doc_node_cmp: order svm nodes by index; used by qsort */
+static int corpus_doc_node_cmp(const void *a, const void *b)
+{
+    int ia = ((const struct svm_node *)a)->index;
+    int ib = ((const struct svm_node *)b)->index;
+    return (ia > ib) - (ia < ib);
+}
+
+/* corpus_doc_vectorize: move the counts of table TF to the sparse vector of
+ * document CDOC ordered by term index; TF is ready for the next document
+ * after this. It returns -1 if we can't allocate the memory */
+int corpus_doc_vectorize(struct corpus_doc *cdoc, struct corpus_tf *tf)
+{
+    /* One extra node for the terminator */
+    struct svm_node *nodes = (struct svm_node *)malloc((tf->nused + 1) * sizeof(struct svm_node));
+    if(nodes == NULL) {
+        return -1;
+    }
+
+    /* Collect the counts of the occupied slots. The signed counts of
+     * hashed terms may cancel out; drop them */
+    long ui, n = 0;
+    for(ui = 0; ui < tf->nused; ui++) {
+        long slot = tf->used[ui];
+        if(tf->counts[slot] != 0) {
+            nodes[n].index = tf->keys[slot];
+            nodes[n].value = tf->counts[slot];
+            n++;
+        }
+    }
+    corpus_tf_reset(tf);
+    qsort(nodes, n, sizeof(struct svm_node), corpus_doc_node_cmp);
+    nodes[n].index = -1;
+    nodes[n].value = 0;
+
+    free(cdoc->nodes);
+    cdoc->nodes = nodes;
+    cdoc->nitems = n;
+    return 0;
+}
+
+/* corpus_doc_print: print the sparse vector representation of the corpus
+ * document */
+void corpus_doc_print(struct corpus_doc *cdoc)
+{
+    long i;
+    for(i = 0; i < cdoc->nitems; i++) {
+        printf("%d:%g ", cdoc->nodes[i].index, cdoc->nodes[i].value);
+    }
+}
+
+/* corpus_doc_destroy: remove corpus document CDOC from memory */
+void corpus_doc_destroy(struct corpus_doc *cdoc)
+{
+    if(cdoc == NULL) return;
+
+    free(cdoc->nodes);
+    free(cdoc->path);
+    free(cdoc);
+}
+
 /* corpus_doc_createf: create document vector representation using TF(term 
- * frequency) from file FP. */
-struct corpus_doc *corpus_doc_createf(char *path, FILE *fp, struct dict *corpus)
+ * frequency) from file FP. The frequencies are counted in table TF. The
+ * tokens are stemmed by STEM if it's not NULL. */
+struct corpus_doc *corpus_doc_createf(char *path, FILE *fp, struct dict *corpus, struct corpus_tf *tf,
+    struct stemmer *stem)
 {
     /* Create corpus doc */
     struct corpus_doc *cdoc = corpus_doc_new(path);
@@ -254,10 +306,10 @@ struct corpus_doc *corpus_doc_createf(char *path, FILE *fp, struct dict *corpus)
         return NULL;
     }
 
-    /* Read every token in the file FP and populate the doc items */
+    /* Read every token in the file FP and count the doc items */
     char token[MAX_TOKEN_CHAR];
     int lentoken;
-    while((lentoken = util_tokenf(token, MAX_TOKEN_CHAR, fp)) != 0) {
+    while((lentoken = util_tokenf(token, MAX_TOKEN_CHAR, fp, NULL, NULL)) != 0) {
         /* The token length is exceeded, so skip the token we get the next 
          * token instead */
         if(lentoken > MAX_TOKEN_CHAR-1) {
@@ -266,42 +318,36 @@ struct corpus_doc *corpus_doc_createf(char *path, FILE *fp, struct dict *corpus)
 
         /* Search the TOKEN in CORPUS dictionary, if the DITEM is NULL then
          * continue to the next token */
-        struct dict_item *ditem = dict_item_search(corpus->root, token);
+        struct dict_item *ditem = dict_search(corpus, stemmer_stem(stem, token));
         if(ditem == NULL) {
             continue;
         }
 
-        /* Create new document item */
-        struct corpus_doc_item *cdoci = corpus_doc_item_new(ditem->index, ditem->term);
-        if(cdoci == NULL) {
-            /* We can't skip this, because the doc item is so important. 
-             * so let's tell the caller */
+        /* We can't skip this, because the doc item is so important. 
+         * so let's tell the caller */
+        if(corpus_tf_push(tf, ditem->index, 1) != 0) {
+            corpus_tf_reset(tf);
+            corpus_doc_destroy(cdoc);
             return NULL;
         }
-
-        /* Insert document item to the root document */
-        cdoc->root = corpus_doc_item_insert(cdoc->root, cdoci);
-        /* If item is inserted to root, then increase the number of document */
-        if(cdoci->is_inserted) {
-            cdoc->nitems += 1;
-        }
-
-        /* if item is not inserted; it's mean that there are exists item with 
-         * the same index as this. just increment the previous item frequency 
-         * and remove this item */
-        if(!cdoci->is_inserted) {
-            corpus_doc_item_destroy(cdoci);
-        }
     }           
 
     /* Return populated document */
+    if(corpus_doc_vectorize(cdoc, tf) != 0) {
+        corpus_tf_reset(tf);
+        corpus_doc_destroy(cdoc);
+        return NULL;
+    }
     return cdoc;
 }
 
 
 /* corpus_doc_createb: create document vector representation using TF(term 
- * frequency) from buffer BUF. */
-struct corpus_doc *corpus_doc_createb(int lenbuf, char *buf, struct dict *index)
+ * frequency) from buffer BUF. Terms are looked up in frozen vocabulary VOCAB
+ * and the frequencies are counted in table TF. The tokens are stemmed by
+ * STEM if it's not NULL. */
+struct corpus_doc *corpus_doc_createb(int lenbuf, char *buf, struct vocab *vocab, struct corpus_tf *tf,
+    struct stemmer *stem)
 {
     /* Create corpus doc */
     struct corpus_doc *cdoc = corpus_doc_new("buffer");
@@ -309,47 +355,199 @@ struct corpus_doc *corpus_doc_createb(int lenbuf, char *buf, struct dict *index)
         return NULL;
     }
 
-    /* Read every token in the file FP and populate the doc items */
-    char token[MAX_TOKEN_CHAR];
+    /* Read every token in the buffer BUF and count the doc items. The
+     * token is resolved to its term id while we read it */
+    long id;
+    int sign;
     int indexbuf = 0;
-    while((indexbuf = util_tokenb(token, MAX_TOKEN_CHAR, indexbuf, buf)) < (lenbuf-1)) {
-        /* Search the TOKEN in CORPUS dictionary, if the DITEM is NULL then
-         * continue to the next token */
-        struct dict_item *ditem = dict_item_search(index->root, token);
-        if(ditem == NULL) {
+    while((indexbuf = vocab_tokenb(vocab, stem, &id, &sign, indexbuf, buf)) < (lenbuf-1)) {
+        /* The token is not exists in frozen vocabulary; continue to the
+         * next token */
+        if(id < 0) {
             continue;
         }
 
-        /* Create new document item */
-        struct corpus_doc_item *cdoci = corpus_doc_item_new(ditem->index, ditem->term);
-        if(cdoci == NULL) {
-            /* We can't skip this, because the doc item is so important. 
-             * so let's tell the caller */
+        /* We can't skip this, because the doc item is so important. 
+         * so let's tell the caller */
+        if(corpus_tf_push(tf, id, sign) != 0) {
+            corpus_tf_reset(tf);
+            corpus_doc_destroy(cdoc);
             return NULL;
         }
+    }           
+
+    if(corpus_doc_vectorize(cdoc, tf) != 0) {
+        corpus_tf_reset(tf);
+        corpus_doc_destroy(cdoc);
+        return NULL;
+    }
+
+    /* Drop the ids that never occur in the training documents; most of
+     * the n-grams of a new document are never seen */
+    long i, j = 0;
+    for(i = 0; i < cdoc->nitems; i++) {
+        if(vocab->idfs[cdoc->nodes[i].index] == VOCAB_UNSEEN) continue;
+        cdoc->nodes[j++] = cdoc->nodes[i];
+    }
+    cdoc->nodes[j] = cdoc->nodes[cdoc->nitems];
+    cdoc->nitems = j;
+
+    /* Return populated document */
+    return cdoc;
+}
+
+/* corpus_doc_hashf: create document vector representation using TF(term 
+ * frequency) from file FP without index vocabulary; each term is mapped to
+ * its signed id in HASHBITS bits. Any words in EXC dictionary are skipped
+ * and the words are stemmed by STEM if it's not NULL. The frequencies are
+ * counted in table TF. */
+struct corpus_doc *corpus_doc_hashf(char *path, FILE *fp, struct dict *exc, struct stemmer *stem,
+    int hashbits, struct corpus_tf *tf)
+{
+    /* Create corpus doc */
+    struct corpus_doc *cdoc = corpus_doc_new(path);
+    if(cdoc == NULL) {
+        return NULL;
+    }
+
+    /* Read every token in the file FP and count the doc items */
+    char token[MAX_TOKEN_CHAR];
+    int lentoken;
+    long excid = -1;
+    while(1) {
+        /* If EXC is compiled, the token is resolved in its trie while
+         * we read it */
+        lentoken = util_tokenf(token, MAX_TOKEN_CHAR, fp, exc ? exc->trie : NULL, &excid);
+        if(lentoken == 0) break;
+
+        /* The token length is exceeded, so skip the token we get the next 
+         * token instead */
+        if(lentoken > MAX_TOKEN_CHAR-1) {
+            continue;
+        }
 
-        /* Insert document item to the root document */
-        cdoc->root = corpus_doc_item_insert(cdoc->root, cdoci);
-        /* If item is inserted to root, then increase the number of document */
-        if(cdoci->is_inserted) {
-            cdoc->nitems += 1;
+        /* Skip the excluded words */
+        if(exc && (exc->trie ? excid >= 0 : dict_contains(exc, token))) {
+            continue;
         }
 
-        /* Ff item is not inserted; it's mean that there are exists item with 
-         * the same index as this. just increment the previous item frequency 
-         * and remove this item */
-        if(!cdoci->is_inserted) {
-            corpus_doc_item_destroy(cdoci);
+        int sign;
+        long id = vocab_hash_id(hashbits, stemmer_stem(stem, token), &sign);
+        if(corpus_tf_push(tf, id, sign) != 0) {
+            corpus_tf_reset(tf);
+            corpus_doc_destroy(cdoc);
+            return NULL;
         }
-    }           
+    }
 
     /* Return populated document */
+    if(corpus_doc_vectorize(cdoc, tf) != 0) {
+        corpus_tf_reset(tf);
+        corpus_doc_destroy(cdoc);
+        return NULL;
+    }
     return cdoc;
 }
 
+/* corpus_doc_hashed: creates representation of each document in the
+ * directory path DIRPATH as a *corpus_doc with hashed term ids in HASHBITS
+ * bits; see corpus_doc_hashf. The word n-grams up to NGRAMS words are
+ * hashed to NGRAMBITS bits after the term ids. The number of documents is
+ * saved to NDOCSP.
+ * There is no index vocabulary, so the documents can be read in any order
+ * and nothing is merged */
+struct corpus_doc **corpus_doc_hashed(char *dirpath, struct dict *exc, struct stemmer *stem,
+    int hashbits, int ngrams, int ngrambits, int *ndocsp)
+{
+    /* The array of *CORPUS_DOC grows as we read the directory */
+    int capacity = CORPUS_DOCS_CAPACITY;
+    struct corpus_doc **cdocs = (struct corpus_doc **)malloc(capacity * sizeof(struct corpus_doc *));
+    if(cdocs == NULL) {
+        return NULL;
+    }
+
+    /* Open the directory */
+    DIR *dir = opendir(dirpath);
+    if(dir == NULL) {
+        return NULL;
+    }
+
+    /* One term frequency table is reused for all documents */
+    struct corpus_tf *tf = corpus_tf_new(CORPUS_TF_BITS);
+    if(tf == NULL) {
+        return NULL;
+    }
+    corpus_tf_ngrams(tf, ngrams, ngrambits, 1L << hashbits);
+
+    /* Scan all files inside directory DIR */
+    int ndocs = 0;
+    struct dirent *ent;
+    while((ent = readdir(dir)) != NULL) {
+        /* We only care if the ENT is a regular file */
+        if(ent->d_type != DT_REG) {
+            continue;
+        }
+
+        /* Get the path to the file ENT */
+        char *path_to_file = (char *)malloc(sizeof(char) * (strlen(dirpath) + strlen(ent->d_name) + 2));
+        if(path_to_file == NULL) {
+            return NULL;
+        }
+        if(dirpath[strlen(dirpath)-1] == '/') {
+            sprintf(path_to_file, "%s%s", dirpath, ent->d_name);
+        } else {
+            sprintf(path_to_file, "%s/%s", dirpath, ent->d_name);
+        }
+
+        /* Read the file */
+        FILE *fp = fopen(path_to_file, "r");
+        if(fp == NULL) {
+            fprintf(stderr, "Couldn't open the file %s; %s\n", path_to_file, strerror(errno));
+            free(path_to_file);
+            continue;
+        }
+
+        /* Grow the array if it's full */
+        if(ndocs == capacity) {
+            capacity *= 2;
+            struct corpus_doc **grown = (struct corpus_doc **)realloc(cdocs, capacity * sizeof(struct corpus_doc *));
+            if(grown == NULL) {
+                return NULL;
+            }
+            cdocs = grown;
+        }
+
+        /* Creates corpus_doc representation for each document */
+        struct corpus_doc *cdoc = corpus_doc_hashf(path_to_file, fp, exc, stem, hashbits, tf);
+        if(cdoc == NULL) {
+            return NULL;
+        }
+        cdocs[ndocs] = cdoc;
+        ndocs += 1;
+
+        if(fclose(fp) != 0) {
+            return NULL;
+        }
+        free(path_to_file);
+    }
+
+    corpus_tf_destroy(tf);
+
+    /* Close the opened directory DIR */
+    if(closedir(dir) != 0) {
+        return NULL;
+    }
+
+    *ndocsp = ndocs;
+    return cdocs;
+}
+
 /* corpus_doc_sparse: creates representation of each document in the directory
- * path DIRPATH as a *corpus_doc */
-struct corpus_doc **corpus_doc_sparse(char *dirpath, struct dict *corpus)
+ * path DIRPATH as a *corpus_doc; the tokens are stemmed by STEM if it's not
+ * NULL. The word n-grams up to NGRAMS words are hashed to NGRAMBITS bits
+ * after the ids of CORPUS */
+struct corpus_doc **corpus_doc_sparse(char *dirpath, struct dict *corpus, struct stemmer *stem,
+    int ngrams, int ngrambits)
 {
     /* Allocate the memory for the array of *CORPUS_DOC */
     struct corpus_doc **cdocs = (struct corpus_doc **)malloc(corpus->ndocs * sizeof(struct corpus_doc *));
@@ -364,6 +562,13 @@ struct corpus_doc **corpus_doc_sparse(char *dirpath, struct dict *corpus)
         return NULL;
     }
 
+    /* One term frequency table is reused for all documents */
+    struct corpus_tf *tf = corpus_tf_new(CORPUS_TF_BITS);
+    if(tf == NULL) {
+        return NULL;
+    }
+    corpus_tf_ngrams(tf, ngrams, ngrambits, corpus->nitems);
+
     /* Keep track of the number of documents; make sure we don't
      * overflow the CDOCS array */
     int ndocs = 0;
@@ -405,7 +610,7 @@ struct corpus_doc **corpus_doc_sparse(char *dirpath, struct dict *corpus)
         }
 
         /* Creates corpus_doc representation for each document */
-        struct corpus_doc *cdoc = corpus_doc_createf(path_to_file, fp, corpus);
+        struct corpus_doc *cdoc = corpus_doc_createf(path_to_file, fp, corpus, tf, stem);
         if(cdoc == NULL) {
             return NULL;
         }
@@ -425,6 +630,8 @@ struct corpus_doc **corpus_doc_sparse(char *dirpath, struct dict *corpus)
         ndocs += 1;    
     }
 
+    corpus_tf_destroy(tf);
+
     /* Close the opened directory DIR */
     if(closedir(dir) != 0) {
         return NULL;
@@ -434,10 +641,11 @@ struct corpus_doc **corpus_doc_sparse(char *dirpath, struct dict *corpus)
 }
 
 /* corpus_index: index all words in DIRPATH and return new CORPUS 
- * dictionary. Any words in EXC dictionary will not indexed.
+ * dictionary. Any words in EXC dictionary will not indexed. The words are
+ * indexed as their stem if STEM is not NULL.
  * Returns NULL if only if error happen and ERRNO will be set to last
  * error. */
-struct dict *corpus_index(char *dirpath, struct dict *exc)
+struct dict *corpus_index(char *dirpath, struct dict *exc, struct stemmer *stem)
 {
     /* Initialize the dictionary */
     struct dict *corpus = dict_new(dirpath);
@@ -488,7 +696,7 @@ struct dict *corpus_index(char *dirpath, struct dict *exc)
         corpus->ndocs += 1;
 
         /* Populate CORPUS dictionary */
-        corpus = dict_populatef(fp, exc, corpus);
+        corpus = dict_populatef(fp, exc, corpus, stem);
         if(corpus == NULL) {
             return NULL;
         }
@@ -510,22 +718,130 @@ struct dict *corpus_index(char *dirpath, struct dict *exc)
     return corpus;
 }
 
-/* compute_index_idf: iterate over all items in index vocabulary INDEX; 
- * then perform check for each document in CDOCS; if the ROOT index 
- * is exists then increase the ROOT ndocs; */
-void corpus_index_idf(int ndocs, struct corpus_doc **cdocs, struct dict_item *root)
+/* corpus_index_items: collect all items of the index vocabulary ROOT
+ * to ITEMS indexed by the item index */
+static void corpus_index_items(struct dict_item *root, struct dict_item **items)
 {
     if(root == NULL) return;
-    if(root->left) corpus_index_idf(ndocs, cdocs, root->left);
-    
+    corpus_index_items(root->left, items);
+    items[root->index] = root;
+    corpus_index_items(root->right, items);
+}
+
+/* corpus_index_df_cmp: order the index items by descending number of
+ * documents; ties keep their first-seen order. Used by qsort */
+static int corpus_index_df_cmp(const void *a, const void *b)
+{
+    const struct dict_item *ia = *(struct dict_item * const *)a;
+    const struct dict_item *ib = *(struct dict_item * const *)b;
+    if(ia->ndocs != ib->ndocs) return (ia->ndocs < ib->ndocs) - (ia->ndocs > ib->ndocs);
+    return (ia->index > ib->index) - (ia->index < ib->index);
+}
+
+/* corpus_index_renumber: renumber the items of index vocabulary INDEX by
+ * descending number of documents, so the most common terms get the
+ * smallest ids and every table indexed by term id keeps them in its first
+ * cache lines. The number of documents is counted by corpus_index. It
+ * returns -1 if we can't allocate the memory */
+int corpus_index_renumber(struct dict *index)
+{
+    long n = index->nitems;
+
+    /* Index starts from 1 */
+    struct dict_item **items = (struct dict_item **)calloc(n + 1, sizeof(struct dict_item *));
+    if(items == NULL) {
+        return -1;
+    }
+    corpus_index_items(index->root, items);
+    qsort(items + 1, n, sizeof(struct dict_item *), corpus_index_df_cmp);
+
+    long i;
+    for(i = 1; i <= n; i++) {
+        items[i]->index = i;
+    }
+
+    free(items);
+    return 0;
+}
+
+/* corpus_index_prune: drop the rare and the too common terms of index
+ * vocabulary INDEX. A term is kept if it's contained in at least MIN_DF
+ * documents and in at most MAX_DF_RATIO of all documents; only the first
+ * MAX_FEATURES of them are kept if MAX_FEATURES is not 0. The terms must be
+ * renumbered first by corpus_index_renumber, so the kept terms are one
+ * range of ids. It returns the pruned index vocabulary with compacted ids
+ * or NULL if we can't allocate the memory; INDEX is not modified */
+struct dict *corpus_index_prune(struct dict *index, long min_df, double max_df_ratio, long max_features)
+{
+    long n = index->nitems;
+
+    /* Number of documents of each id */
+    struct dict_item **items = (struct dict_item **)calloc(n + 1, sizeof(struct dict_item *));
+    if(items == NULL) {
+        return NULL;
+    }
+    corpus_index_items(index->root, items);
+
+    /* The number of documents is descending by id; the too common terms
+     * are at the beginning and the rare terms are at the end */
+    double max_df = max_df_ratio * index->ndocs;
+    long first = 1;
+    while(first <= n && items[first]->ndocs > max_df) first++;
+    long last = n;
+    while(last >= first && items[last]->ndocs < min_df) last--;
+    if(max_features > 0 && last - first + 1 > max_features) {
+        last = first + max_features - 1;
+    }
+    free(items);
+
+    return dict_slice(index, first, last);
+}
+
+/* corpus_df: count the number of documents in CDOCS that contain each id
+ * up to NIDS. It returns the array of NIDS+1 counts indexed by id or NULL
+ * if we can't allocate the memory */
+int *corpus_df(int ndocs, struct corpus_doc **cdocs, long nids)
+{
+    int *dfs = (int *)calloc(nids + 1, sizeof(int));
+    if(dfs == NULL) {
+        return NULL;
+    }
+
+    int cdi;
+    for(cdi = 0; cdi < ndocs; cdi++) {
+        struct svm_node *node;
+        for(node = cdocs[cdi]->nodes; node->index != -1; node++) {
+            dfs[node->index] += 1;
+        }
+    }
+
+    return dfs;
+}
+
+/* corpus_prune_df: drop the ids between FIRST and LAST that are contained
+ * in less than MIN_DF documents from the document vectors in CDOCS; their
+ * number of documents in DFS is set to 0. It returns the number of ids
+ * between FIRST and LAST that are kept */
+long corpus_prune_df(int ndocs, struct corpus_doc **cdocs, int *dfs, long first, long last, long min_df)
+{
+    long id, nkept = 0;
+    for(id = first; id <= last; id++) {
+        if(dfs[id] < min_df) dfs[id] = 0;
+        if(dfs[id] > 0) nkept++;
+    }
+
+    /* The order of the kept ids doesn't change */
     int cdi;
     for(cdi = 0; cdi < ndocs; cdi++) {
-        /* check if the root->index is exists in document cdoc */
-        int exists = corpus_doc_item_exists(cdocs[cdi]->root, root->index);
-        if(exists) {
-            root->ndocs += 1;
+        struct corpus_doc *cdoc = cdocs[cdi];
+        long i, j = 0;
+        for(i = 0; i < cdoc->nitems; i++) {
+            if(dfs[cdoc->nodes[i].index] == 0) continue;
+            cdoc->nodes[j++] = cdoc->nodes[i];
         }
+        cdoc->nodes[j] = cdoc->nodes[cdoc->nitems];
+        cdoc->nitems = j;
     }
 
-    if(root->right) corpus_index_idf(ndocs, cdocs, root->right);
-}
\ No newline at end of file
+    return nkept;
+}
@@ -2,9 +2,15 @@
  * Collection of common function to manage the corpus of sayoeti.
  * - Create index vocabulary from corpus
  * - Create vector representation sparse vector of document using
- *   TF(term frequency)
+ *   TF(term frequency); the frequencies are counted in a reusable hash
+ *   table and sorted by term id into a contiguous array of svm_node
  * - Compute IDF(Inverse document frequency) for each term in 
  *   Index vocabulary
+ * - Renumber the terms by document frequency, so the common terms have
+ *   the smallest ids
+ * - Prune the rare and the too common terms
+ * - Or skip the index vocabulary; hash each term to its id
+ * - Add the hashed word n-grams of the id stream next to the terms
  *
  * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
  * 
@@ -23,25 +29,47 @@
 
 #ifndef CORPUS_H
 #define CORPUS_H
- 
-/* corpus_doc_item: represents unique token in the document */
-struct corpus_doc_item {
-    /* The index of item in corpus dictionary */
-    long index;
-
-    /* This will enable us to lookup global information like IDF
-     * from corpus dictionary */
-    char *term;
-
-    /* Keep track of inserted document */
-    int is_inserted;
-    
-    /* Keep track of the TF (term frequency) int the document */
-    int frequency;
-
-    /* Height, Left and Right for the AVL tree */
-    int height;
-    struct corpus_doc_item *left, *right;
+
+#include <stdio.h>
+
+#include "../deps/libsvm/svm.h"
+#include "vocab.h"
+
+struct dict;
+struct stemmer;
+
+/* Macros */
+/* Initial term frequency table has 2^CORPUS_TF_BITS slots */
+#define CORPUS_TF_BITS 10
+/* Initial capacity of the array of documents of unknown size */
+#define CORPUS_DOCS_CAPACITY 64
+
+/* corpus_tf: reusable open-addressing table that counts the frequency of
+ * each term id in one document */
+struct corpus_tf {
+    /* Number of slots is 2^BITS */
+    int bits;
+    long size;
+
+    /* Term id (0 if the slot is empty) and its frequency in each slot */
+    int *keys;
+    int *counts;
+
+    /* Occupied slots; so we can collect the counts and reset the table
+     * without scanning all slots */
+    long *used;
+    long nused;
+
+    /* Word n-grams up to NGRAMS words are counted too; 1 if only the
+     * terms are counted. Each n-gram is hashed to one of 2^NGRAMBITS ids
+     * after the id NGRAMBASE */
+    int ngrams;
+    int ngrambits;
+    long ngrambase;
+
+    /* The last NHISTORY term ids of the document; the oldest first */
+    long history[VOCAB_MAX_NGRAMS-1];
+    int nhistory;
 };
 
 /* corpus_doc: represents the corpus document */
@@ -52,27 +80,38 @@ struct corpus_doc {
     /* Keep track of how many items in the document */
     long nitems; 
 
-    /* Local dictionry of docment; ordered by the number of
-     * index in index vocabulary */
-    struct corpus_doc_item *root;
+    /* Sparse vector of the document ordered by the index in index
+     * vocabulary and terminated by index -1. The value is the frequency
+     * of the term until it's weighted by train_node_create */
+    struct svm_node *nodes;
 };
 
 /* Prototypes */
-struct corpus_doc_item *corpus_doc_item_new(long index, char *term);
-void corpus_doc_item_destroy(struct corpus_doc_item *cdoci);
-int corpus_doc_item_height(struct corpus_doc_item *item);
-int corpus_doc_item_get_balance(struct corpus_doc_item *item);
-struct corpus_doc_item *corpus_doc_item_rotate_right(struct corpus_doc_item *item);
-struct corpus_doc_item *corpus_doc_item_rotate_left(struct corpus_doc_item *item);
-struct corpus_doc_item *corpus_doc_item_insert(struct corpus_doc_item *root, struct corpus_doc_item *item);
-void corpus_doc_item_print(struct corpus_doc_item *root);
-int corpus_doc_item_exists(struct corpus_doc_item *root, long index);
+struct corpus_tf *corpus_tf_new(int bits);
+void corpus_tf_ngrams(struct corpus_tf *tf, int ngrams, int ngrambits, long ngrambase);
+int corpus_tf_add(struct corpus_tf *tf, long index, int count);
+int corpus_tf_push(struct corpus_tf *tf, long index, int sign);
+void corpus_tf_reset(struct corpus_tf *tf);
+void corpus_tf_destroy(struct corpus_tf *tf);
 
 struct corpus_doc *corpus_doc_new(char *path);
-struct corpus_doc *corpus_doc_createf(char *path, FILE *fp, struct dict *index);
-struct corpus_doc *corpus_doc_createb(int lenbuf, char *buf, struct dict *index);
-struct corpus_doc **corpus_doc_sparse(char *dirpath, struct dict *index);
-struct dict *corpus_index(char *dirpath, struct dict *exc);
-void corpus_index_idf(int ndocs, struct corpus_doc **cdocs, struct dict_item *root);
+int corpus_doc_vectorize(struct corpus_doc *cdoc, struct corpus_tf *tf);
+void corpus_doc_print(struct corpus_doc *cdoc);
+void corpus_doc_destroy(struct corpus_doc *cdoc);
+struct corpus_doc *corpus_doc_createf(char *path, FILE *fp, struct dict *index, struct corpus_tf *tf,
+    struct stemmer *stem);
+struct corpus_doc *corpus_doc_createb(int lenbuf, char *buf, struct vocab *vocab, struct corpus_tf *tf,
+    struct stemmer *stem);
+struct corpus_doc **corpus_doc_sparse(char *dirpath, struct dict *index, struct stemmer *stem,
+    int ngrams, int ngrambits);
+struct corpus_doc *corpus_doc_hashf(char *path, FILE *fp, struct dict *exc, struct stemmer *stem,
+    int hashbits, struct corpus_tf *tf);
+struct corpus_doc **corpus_doc_hashed(char *dirpath, struct dict *exc, struct stemmer *stem,
+    int hashbits, int ngrams, int ngrambits, int *ndocsp);
+struct dict *corpus_index(char *dirpath, struct dict *exc, struct stemmer *stem);
+int corpus_index_renumber(struct dict *index);
+struct dict *corpus_index_prune(struct dict *index, long min_df, double max_df_ratio, long max_features);
+int *corpus_df(int ndocs, struct corpus_doc **cdocs, long nids);
+long corpus_prune_df(int ndocs, struct corpus_doc **cdocs, int *dfs, long first, long last, long min_df);
 
 #endif
\ No newline at end of file
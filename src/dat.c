@@ -0,0 +1,220 @@
+/* Sayoeti Double-Array Trie
+ * Read-only prefix-sharing automaton that maps each term of the dictionary
+ * to its index. Indonesian terms share a lot of affixes (me-, ber-, di-,
+ * -kan, -nya), so the trie stores them more compactly than separate string
+ * copies, and it can be walked one character at a time while tokenizing.
+ *
+ * State S goes to state T = BASE[S] + C on character C if CHECK[T] == S.
+ * The terminator (character 0) leads to a leaf that keeps the index of
+ * the term as -(BASE[T] + 1).
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dict.h"
+#include "dat.h"
+
+/* Number of possible characters including the terminator */
+#define DAT_NCODES 257
+
+/* dat_resize: grow the double array T to hold at least SIZE cells. It
+ * returns -1 if we can't allocate the memory */
+static int dat_resize(struct dat *t, long size)
+{
+    if(size <= t->size) return 0;
+
+    long newsize = (t->size > 0) ? t->size : 1024;
+    while(newsize < size) newsize *= 2;
+
+    int32_t *base = (int32_t *)realloc(t->base, newsize * sizeof(int32_t));
+    if(base == NULL) {
+        return -1;
+    }
+    t->base = base;
+
+    int32_t *check = (int32_t *)realloc(t->check, newsize * sizeof(int32_t));
+    if(check == NULL) {
+        return -1;
+    }
+    t->check = check;
+
+    long i;
+    for(i = t->size; i < newsize; i++) {
+        t->base[i] = 0;
+        t->check[i] = DAT_FREE;
+    }
+    t->size = newsize;
+    return 0;
+}
+
+/* dat_items_collect: collect all items of the dictionary ROOT to ITEMS
+ * in alphabetical order */
+static void dat_items_collect(struct dict_item *root, struct dict_item **items, long *n)
+{
+    if(root == NULL) return;
+    dat_items_collect(root->left, items, n);
+    items[*n] = root;
+    *n += 1;
+    dat_items_collect(root->right, items, n);
+}
+
+/* dat_insert: insert the sorted ITEMS[LO..HI) that share the first DEPTH
+ * characters as the children of state STATE. NEXT is the first free cell
+ * we know of. It returns -1 if we can't allocate the memory */
+static int dat_insert(struct dat *t, long *next, struct dict_item **items,
+    long lo, long hi, int depth, long state)
+{
+    /* Get the distinct characters at DEPTH; the items are sorted so
+     * the same characters are adjacent and the terminator comes first */
+    int codes[DAT_NCODES];
+    long starts[DAT_NCODES + 1];
+    int nc = 0;
+    long i;
+    for(i = lo; i < hi; i++) {
+        int c = (unsigned char)items[i]->term[depth];
+        if(nc == 0 || codes[nc-1] != c) {
+            codes[nc] = c;
+            starts[nc] = i;
+            nc++;
+        }
+    }
+    starts[nc] = hi;
+
+    /* Find the base where all the children fall into free cells */
+    long pos = (*next > codes[0] + 1) ? *next : codes[0] + 1;
+    long b;
+    int j;
+    while(1) {
+        if(dat_resize(t, pos + DAT_NCODES) != 0) {
+            return -1;
+        }
+        if(t->check[pos] != DAT_FREE) {
+            pos++;
+            continue;
+        }
+
+        b = pos - codes[0];
+        int ok = TRUE;
+        for(j = 1; j < nc && ok; j++) {
+            if(t->check[b + codes[j]] != DAT_FREE) ok = FALSE;
+        }
+        if(ok) break;
+        pos++;
+    }
+
+    t->base[state] = (int32_t)b;
+    for(j = 0; j < nc; j++) {
+        t->check[b + codes[j]] = (int32_t)state;
+    }
+    while(t->check[*next] != DAT_FREE) *next += 1;
+
+    /* The terminator keeps the index; other characters go deeper */
+    for(j = 0; j < nc; j++) {
+        long child = b + codes[j];
+        if(codes[j] == 0) {
+            t->base[child] = (int32_t)(-items[starts[j]]->index - 1);
+            continue;
+        }
+        if(dat_insert(t, next, items, starts[j], starts[j+1], depth + 1, child) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* dat_build: build the double-array trie from all terms in dictionary D.
+ * Returns NULL if only if error happen and ERRNO will be set to last
+ * error. */
+struct dat *dat_build(struct dict *d)
+{
+    struct dat *t = (struct dat *)malloc(sizeof(struct dat));
+    if(t == NULL) {
+        return NULL;
+    }
+    t->size = 0;
+    t->nitems = d->nitems;
+    t->base = NULL;
+    t->check = NULL;
+
+    struct dict_item **items = (struct dict_item **)malloc((d->nitems + 1) * sizeof(struct dict_item *));
+    if(items == NULL || dat_resize(t, DAT_NCODES) != 0) {
+        free(items);
+        dat_destroy(t);
+        return NULL;
+    }
+
+    /* The root is never a child of other state */
+    t->check[DAT_ROOT] = DAT_ROOT;
+
+    long n = 0;
+    dat_items_collect(d->root, items, &n);
+
+    long next = 1;
+    if(n > 0 && dat_insert(t, &next, items, 0, n, 0, DAT_ROOT) != 0) {
+        free(items);
+        dat_destroy(t);
+        return NULL;
+    }
+
+    free(items);
+    return t;
+}
+
+/* dat_walk: go from state STATE on character C. It returns the next state
+ * or -1 if no term continues with C */
+long dat_walk(struct dat *t, long state, int c)
+{
+    long next = (long)t->base[state] + (unsigned char)c;
+    if(next <= 0 || next >= t->size || t->check[next] != state) {
+        return -1;
+    }
+    return next;
+}
+
+/* dat_value: get the index of the term that ends at state STATE. It
+ * returns -1 if no term ends here */
+long dat_value(struct dat *t, long state)
+{
+    long leaf = t->base[state];
+    if(leaf <= 0 || leaf >= t->size || t->check[leaf] != state) {
+        return -1;
+    }
+    return -(long)t->base[leaf] - 1;
+}
+
+/* dat_search: search the term TERM in the trie T. It returns the index of
+ * the term or -1 if the term is not exists */
+long dat_search(struct dat *t, char *term)
+{
+    long state = DAT_ROOT;
+    while(*term && state >= 0) {
+        state = dat_walk(t, state, *term++);
+    }
+    if(state < 0) return -1;
+    return dat_value(t, state);
+}
+
+/* dat_destroy: remove the trie T from memory */
+void dat_destroy(struct dat *t)
+{
+    if(t == NULL) return;
+    free(t->base);
+    free(t->check);
+    free(t);
+}
@@ -0,0 +1,54 @@
+/* Sayoeti Double-Array Trie
+ * Read-only prefix-sharing automaton that maps each term of the dictionary
+ * to its index. Indonesian terms share a lot of affixes (me-, ber-, di-,
+ * -kan, -nya), so the trie stores them more compactly than separate string
+ * copies, and it can be walked one character at a time while tokenizing.
+ *
+ * State S goes to state T = BASE[S] + C on character C if CHECK[T] == S.
+ * The terminator (character 0) leads to a leaf that keeps the index of
+ * the term as -(BASE[T] + 1).
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DAT_H
+#define DAT_H
+
+#include <stdint.h>
+
+/* Macros */
+/* The state before reading any character */
+#define DAT_ROOT 0
+/* Unused cell of the double array */
+#define DAT_FREE -1
+
+/* dat: represents the double-array trie */
+struct dat {
+    /* Number of cells and number of terms */
+    long size;
+    long nitems;
+
+    int32_t *base;
+    int32_t *check;
+};
+
+/* Prototypes */
+struct dat *dat_build(struct dict *d);
+long dat_walk(struct dat *t, long state, int c);
+long dat_value(struct dat *t, long state);
+long dat_search(struct dat *t, char *term);
+void dat_destroy(struct dat *t);
+
+#endif
@@ -23,30 +23,41 @@
  #include <string.h>
 
  #include "dict.h"
+ #include "arena.h"
+ #include "bloom.h"
+ #include "dat.h"
+ #include "stemmer.h"
+ #include "vocab.h"
  #include "utils.h"
 
-/* dict_item_new: creates new dictionary item with term TERM */
-struct dict_item *dict_item_new(char *term)
+/* Size of each chunk of interned terms and number of items in each slab */
+#define DICT_TERMS_CHUNK 65536
+#define DICT_ITEMS_SLAB 1024
+/* Initial number of terms of the dictionary Bloom filter */
+#define DICT_FILTER_ITEMS 1024
+
+/* dict_item_new: creates new dictionary item with term TERM. The item is
+ * allocated from the slab pool of dictionary D and the term is interned in
+ * its string arena; both are released by dict_destroy */
+struct dict_item *dict_item_new(struct dict *d, char *term)
 {
-    struct dict_item *item = (struct dict_item *)malloc(sizeof(struct dict_item));
+    struct dict_item *item = (struct dict_item *)pool_alloc(d->items);
     if(item == NULL) {
         return NULL;
     }
 
-    /* Copy term to new memory; to avoid the term removed from the outside of 
-     * dict_item_destroy */
-    char *t = (char *)malloc(sizeof(char) * (strlen(term) + 1));
+    /* Intern the term; so it's not removed from the outside of 
+     * dict_destroy */
+    char *t = arena_strdup(d->terms, term);
     if(t == NULL) {
         return NULL;
     }
 
-    /* Copy TERM to T */
-    strcpy(t, term);
-
     item->index = 0;
     item->term = t;
     item->is_inserted = FALSE;
     item->ndocs = 0;
+    item->lastdoc = 0;
     item->height = 1;
     item->left = NULL;
     item->right = NULL;
@@ -54,21 +65,6 @@ struct dict_item *dict_item_new(char *term)
     return item;
 }
 
-/* dict_item_destroy: recursively free all allocated memory for the dictionary
- * items; started from dictionary items ROOT */
-void dict_item_destroy(struct dict_item *root) 
-{
-    if(root == NULL) {
-        return;
-    } 
-
-    dict_item_destroy(root->left);
-    dict_item_destroy(root->right);
-
-    free(root->term);
-    free(root);
-}
-
 /* dict_item_height: get the height of dictionary item ITEM */
 int dict_item_height(struct dict_item *item)
 {
@@ -230,6 +226,76 @@ struct dict_item *dict_item_search(struct dict_item *root, char *term)
     return NULL;
 }
 
+/* dict_filter_fill: recursively add all terms from root dictionary ROOT to
+ * the Bloom filter FILTER */
+static void dict_filter_fill(struct bloom *filter, struct dict_item *root)
+{
+    if(root == NULL) return;
+    dict_filter_fill(filter, root->left);
+    bloom_add(filter, vocab_hash(DICT_HASH_SEED, root->term));
+    dict_filter_fill(filter, root->right);
+}
+
+/* dict_filter_add: add the term TERM to the Bloom filter of dictionary D.
+ * The filter is rebuilt twice as big when it's full, so the false positive
+ * rate stay low while the dictionary grows. It returns -1 if we can't
+ * allocate the new filter */
+static int dict_filter_add(struct dict *d, char *term)
+{
+    if(d->nitems > d->filter->capacity) {
+        struct bloom *filter = bloom_new(d->filter->capacity * 2);
+        if(filter == NULL) {
+            return -1;
+        }
+        dict_filter_fill(filter, d->root);
+        bloom_destroy(d->filter);
+        d->filter = filter;
+        return 0;
+    }
+
+    bloom_add(d->filter, vocab_hash(DICT_HASH_SEED, term));
+    return 0;
+}
+
+/* dict_search: search the term TERM in dictionary D. The Bloom filter is
+ * checked first; most of the misses never touch the tree. It returns NULL
+ * if the term is not exists in dictionary */
+struct dict_item *dict_search(struct dict *d, char *term)
+{
+    if(!bloom_check(d->filter, vocab_hash(DICT_HASH_SEED, term))) {
+        return NULL;
+    }
+    return dict_item_search(d->root, term);
+}
+
+/* dict_contains: check wether the term TERM is in dictionary D. The trie
+ * backend is used if the dictionary is compiled. It returns TRUE if the
+ * term is found, otherwise FALSE */
+int dict_contains(struct dict *d, char *term)
+{
+    if(!bloom_check(d->filter, vocab_hash(DICT_HASH_SEED, term))) {
+        return FALSE;
+    }
+    if(d->trie) {
+        return dat_search(d->trie, term) >= 0;
+    }
+    return dict_item_search(d->root, term) != NULL;
+}
+
+/* dict_compile: build the double-array trie backend of dictionary D. The
+ * dictionary should not be populated anymore. It returns 0 on success,
+ * otherwise -1 and ERRNO will be set to last error */
+int dict_compile(struct dict *d)
+{
+    struct dat *trie = dat_build(d);
+    if(trie == NULL) {
+        return -1;
+    }
+    dat_destroy(d->trie);
+    d->trie = trie;
+    return 0;
+}
+
 /* dict_item_print: recursivly print each item in the dictionary 
  * in alphabetical order. */
 void dict_item_print(struct dict_item *root)
@@ -261,18 +327,74 @@ struct dict *dict_new(char *source)
     /* copy SOURCE to S */
     strcpy(s, source);
 
+    /* Create the string arena and the slab pool of items */
+    d->terms = arena_new(DICT_TERMS_CHUNK);
+    d->items = pool_new(sizeof(struct dict_item), DICT_ITEMS_SLAB);
+    d->filter = bloom_new(DICT_FILTER_ITEMS);
+    if(d->terms == NULL || d->items == NULL || d->filter == NULL) {
+        return NULL;
+    }
+
     d->source = s;
     d->ndocs = 0;
     d->nitems = 0;
     d->root = NULL;
+    d->trie = NULL;
     return d;
 }
 
+/* dict_slice_fill: recursively copy the items of root dictionary ROOT with
+ * index between FIRST and LAST to dictionary D. It returns -1 if we can't
+ * allocate the new items */
+static int dict_slice_fill(struct dict *d, struct dict_item *root, long first, long last)
+{
+    if(root == NULL) return 0;
+    if(dict_slice_fill(d, root->left, first, last) != 0) return -1;
+
+    if(root->index >= first && root->index <= last) {
+        struct dict_item *item = dict_item_new(d, root->term);
+        if(item == NULL) {
+            return -1;
+        }
+        item->index = root->index - first + 1;
+        item->ndocs = root->ndocs;
+        d->root = dict_item_insert(d->root, item);
+        d->nitems += 1;
+        if(dict_filter_add(d, item->term) != 0) {
+            return -1;
+        }
+    }
+
+    return dict_slice_fill(d, root->right, first, last);
+}
+
+/* dict_slice: create new dictionary from the items of dictionary D with
+ * index between FIRST and LAST; the items are renumbered from 1 and keep
+ * their number of documents. Returns NULL if only if error happen and
+ * ERRNO will be set to last error. */
+struct dict *dict_slice(struct dict *d, long first, long last)
+{
+    struct dict *slice = dict_new(d->source);
+    if(slice == NULL) {
+        return NULL;
+    }
+    slice->ndocs = d->ndocs;
+
+    if(dict_slice_fill(slice, d->root, first, last) != 0) {
+        dict_destroy(slice);
+        return NULL;
+    }
+    return slice;
+}
+
 /* dict_destroy: remove dictionary D from memory */
 void dict_destroy(struct dict *d)
 {   
-    /* Remove all items from dictionary */
-    dict_item_destroy(d->root);
+    /* Remove all items and terms from dictionary */
+    pool_destroy(d->items);
+    arena_destroy(d->terms);
+    bloom_destroy(d->filter);
+    dat_destroy(d->trie);
     free(d->source);
     free(d);
 }
@@ -287,50 +409,72 @@ void dict_printout(struct dict *d)
 
 /* dict_populatef: Populates dictionary D items from file FP.
  * The item is inserted if not exists in SW. If EXC is NULL then 
- * exists checking is omitted. It returns populated dictionary
+ * exists checking is omitted. The tokens are checked in EXC as is and
+ * inserted as their stem if STEM is not NULL. The file is the document
+ * number D->ndocs; the number of documents of each item is counted while
+ * we read it. It returns populated dictionary
  *
  * Note:
  * Potential data races here. We incremented the dictionary->nitems
  * here, if we access the same object on multiple threads data races
  * can happen. */
-struct dict *dict_populatef(FILE *fp, struct dict *exc, struct dict *d)
+struct dict *dict_populatef(FILE *fp, struct dict *exc, struct dict *d, struct stemmer *stem)
 {
     /* Read every token in the file FP and populate the dictionary D
      * exlude all files in dictioanary EXC */
     char token[MAX_TOKEN_CHAR];
     int lentoken;
-    while((lentoken = util_tokenf(token, MAX_TOKEN_CHAR, fp)) != 0) {
-        /* Create new dictionary item with term TOKEN */
-        struct dict_item *vocab = dict_item_new(token);
-        if(vocab == NULL) {
-            return NULL;
+    long excid = -1;
+    while(1) {
+        /* If EXC is compiled, the token is resolved in its trie while
+         * we read it */
+        lentoken = util_tokenf(token, MAX_TOKEN_CHAR, fp, exc ? exc->trie : NULL, &excid);
+        if(lentoken == 0) break;
+
+        /* The token length is exceeded; the documents skip it too */
+        if(lentoken > MAX_TOKEN_CHAR-1) {
+            continue;
         }
-        
+
         /* Check wether the words is in EXC (excluded) directory
          * or not. */
-        int exists = FALSE;
-        if(exc) {
-            exists = dict_item_exists(exc->root, vocab);
+        if(exc && (exc->trie ? excid >= 0 : dict_contains(exc, token))) {
+            continue;
         }
 
-        /* Insert the dictionary item if the word is not exists */
-        if(!exists) {
-            /* Insert dictionary item VOCAB to a dictionary root D */
-            d->root = dict_item_insert(d->root, vocab);
-
-            /* NOTE(pyk): Potential data races */
-            /* Keep track of newly inserted items */
-            if(vocab->is_inserted) {
-                /* increment nitems, update vocab */
-                d->nitems += 1;
-                vocab->index = d->nitems;
+        /* Most tokens are already in dictionary D; don't allocate
+         * anything for them */
+        char *term = stemmer_stem(stem, token);
+        struct dict_item *prev = dict_search(d, term);
+        if(prev != NULL) {
+            if(prev->lastdoc != d->ndocs) {
+                prev->ndocs += 1;
+                prev->lastdoc = d->ndocs;
             }
+            continue;
+        }
+
+        /* Create new dictionary item with term TOKEN */
+        struct dict_item *vocab = dict_item_new(d, term);
+        if(vocab == NULL) {
+            return NULL;
         }
 
-        /* Remove if the item is exists in dictionary EXC */
-        if(exists) {
-            dict_item_destroy(vocab);
-        }        
+        /* Insert dictionary item VOCAB to a dictionary root D */
+        d->root = dict_item_insert(d->root, vocab);
+
+        /* NOTE(pyk): Potential data races */
+        /* Keep track of newly inserted items; increment nitems,
+         * update vocab */
+        d->nitems += 1;
+        vocab->index = d->nitems;
+        vocab->ndocs = 1;
+        vocab->lastdoc = d->ndocs;
+
+        /* Keep the Bloom filter in sync with the tree */
+        if(dict_filter_add(d, vocab->term) != 0) {
+            return NULL;
+        }
     }
 
     /* Return populated dictionary */
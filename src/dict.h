@@ -27,12 +27,16 @@
 /* This is the maximum number of characters in one token.
  * see: https://en.wikipedia.org/wiki/Longest_Words#Indonesian */
 #define MAX_TOKEN_CHAR 31
+/* Seed of vocab_hash for the Bloom filter of the dictionary and the stem
+ * cache */
+#define DICT_HASH_SEED 0
 
 /* dict_item: represents a node of AVL Binary Search Tree (BST);
  * ii used as one word in dictionary */
 struct dict_item {
     /* Basic info for each item in dictionary; 
-     * unique index and string term */
+     * unique index and string term. The term is interned in the
+     * dictionary string arena */
     long index;
     char *term;
 
@@ -46,6 +50,10 @@ struct dict_item {
      * This is for computing IDF */
     int ndocs;
 
+    /* The last document that contains this item; so each document
+     * is counted once in NDOCS */
+    long lastdoc;
+
     struct dict_item *left, *right;
 };
 
@@ -64,12 +72,27 @@ struct dict {
 
     /* The root of dictionary */
     struct dict_item *root;
+
+    /* Interned terms and the slab pool of items; both are released
+     * at once by dict_destroy */
+    struct arena *terms;
+    struct pool *items;
+
+    /* Bloom filter of all terms; lookups check it first so the
+     * definite misses skip the tree */
+    struct bloom *filter;
+
+    /* Optional double-array trie backend; built by dict_compile once
+     * the dictionary is complete */
+    struct dat *trie;
 };
 
 
+/* The stemmer is optional; see stemmer.h */
+struct stemmer;
+
 /* Prototypes */
-struct dict_item *dict_item_new(char *term);
-void dict_item_destroy(struct dict_item *root);
+struct dict_item *dict_item_new(struct dict *d, char *term);
 int dict_item_height_max(int h1, int h2);
 int dict_item_height(struct dict_item *item);
 int dict_item_get_balance(struct dict_item *item);
@@ -81,8 +104,12 @@ struct dict_item *dict_item_search(struct dict_item *root, char *term);
 void dict_item_print(struct dict_item *root);
 
 struct dict *dict_new(char *source);
+struct dict_item *dict_search(struct dict *d, char *term);
+int dict_contains(struct dict *d, char *term);
+int dict_compile(struct dict *d);
+struct dict *dict_slice(struct dict *d, long first, long last);
 void dict_destroy(struct dict *d);
 void dict_printout(struct dict *d);
-struct dict *dict_populatef(FILE *fp, struct dict *exc, struct dict *d);
+struct dict *dict_populatef(FILE *fp, struct dict *exc, struct dict *d, struct stemmer *stem);
 
 #endif
\ No newline at end of file
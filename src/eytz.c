@@ -0,0 +1,215 @@
+/* Sayoeti Sorted Vocabulary
+ * Read-only ordered layout of the dictionary for the prefix queries of
+ * --terms and the deterministic dump of the index vocabulary under --debug.
+ * The AVL tree of the dictionary is flattened into breadth-first
+ * (Eytzinger) order, so the binary search walks the array from the top and
+ * the next levels can be prefetched, and the terms are walked in
+ * alphabetical order without recursion.
+ *
+ * Each term is stored as fixed width key padded with zeroes; a term have
+ * at most MAX_TOKEN_CHAR-1 characters so one key fits in 32 bytes and it
+ * can be compared with two 16-byte SIMD compares instead of strcmp.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "dict.h"
+#include "eytz.h"
+
+/* eytz_cmp: compare two zero padded keys A and B in lexicographical order.
+ * It returns negative integer if A < B, 0 if A == B and positive integer
+ * if A > B. Both keys must be aligned to 16 bytes. */
+static inline int eytz_cmp(const char *a, const char *b)
+{
+#ifdef __SSE2__
+    __m128i a0 = _mm_load_si128((const __m128i *)a);
+    __m128i a1 = _mm_load_si128((const __m128i *)(a + 16));
+    __m128i b0 = _mm_load_si128((const __m128i *)b);
+    __m128i b1 = _mm_load_si128((const __m128i *)(b + 16));
+    unsigned int eq = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0))
+        | ((unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1)) << 16);
+    /* The first different byte decides the order. The last byte is always
+     * the terminator, so we compare it when both keys are equal */
+    int i = __builtin_ctz(~eq | 0x80000000u);
+    return (unsigned char)a[i] - (unsigned char)b[i];
+#else
+    return memcmp(a, b, EYTZ_KEY_SIZE);
+#endif
+}
+
+/* eytz_key: copy the term TERM to zero padded key KEY. It returns FALSE
+ * if the term doesn't fit into one key */
+static int eytz_key(char *key, char *term)
+{
+    size_t len = strlen(term);
+    if(len > EYTZ_KEY_SIZE - 1) {
+        return FALSE;
+    }
+    memset(key, 0, EYTZ_KEY_SIZE);
+    memcpy(key, term, len);
+    return TRUE;
+}
+
+/* eytz_items_collect: collect all items of the dictionary ROOT to ITEMS
+ * in alphabetical order */
+static void eytz_items_collect(struct dict_item *root, struct dict_item **items, long *n)
+{
+    if(root == NULL) return;
+    eytz_items_collect(root->left, items, n);
+    items[*n] = root;
+    *n += 1;
+    eytz_items_collect(root->right, items, n);
+}
+
+/* eytz_fill: place the sorted ITEMS to the subtree at position K of the
+ * sorted vocabulary E. I is the index of the next item to be placed */
+static long eytz_fill(struct eytz *e, struct dict_item **items, long i, long k)
+{
+    if(k > e->nitems) return i;
+
+    i = eytz_fill(e, items, i, 2*k);
+
+    /* The term always fit; terms are shorter than MAX_TOKEN_CHAR */
+    eytz_key(e->keys[k], items[i]->term);
+    e->indexes[k] = items[i]->index;
+    e->ndocs[k] = items[i]->ndocs;
+    i += 1;
+
+    return eytz_fill(e, items, i, 2*k + 1);
+}
+
+/* eytz_build: flatten the dictionary D into sorted vocabulary. Returns NULL
+ * if only if error happen and ERRNO will be set to last error. */
+struct eytz *eytz_build(struct dict *d)
+{
+    struct eytz *e = (struct eytz *)malloc(sizeof(struct eytz));
+    if(e == NULL) {
+        return NULL;
+    }
+
+    /* Position 0 is not used */
+    long n = d->nitems;
+    e->nitems = n;
+    if(posix_memalign((void **)&e->keys, EYTZ_KEY_SIZE, (n + 1) * EYTZ_KEY_SIZE) != 0) {
+        e->keys = NULL;
+    }
+    e->indexes = (long *)malloc((n + 1) * sizeof(long));
+    e->ndocs = (int *)malloc((n + 1) * sizeof(int));
+    struct dict_item **items = (struct dict_item **)malloc((n + 1) * sizeof(struct dict_item *));
+    if(e->keys == NULL || e->indexes == NULL || e->ndocs == NULL || items == NULL) {
+        free(items);
+        eytz_destroy(e);
+        return NULL;
+    }
+    memset(e->keys, 0, (n + 1) * EYTZ_KEY_SIZE);
+
+    long ni = 0;
+    eytz_items_collect(d->root, items, &ni);
+    eytz_fill(e, items, 0, 1);
+    free(items);
+
+    return e;
+}
+
+/* eytz_lower_bound: get the position of the first term that is not less
+ * than TERM in sorted vocabulary E. It returns 0 if all terms are less than
+ * TERM. */
+long eytz_lower_bound(struct eytz *e, char *term)
+{
+    char key[EYTZ_KEY_SIZE] __attribute__((aligned(EYTZ_KEY_SIZE)));
+    if(!eytz_key(key, term)) {
+        /* Longer terms are ordered right after their 31 chars prefix */
+        memcpy(key, term, EYTZ_KEY_SIZE - 1);
+        key[EYTZ_KEY_SIZE - 1] = 1;
+    }
+
+    /* Branchless descent; go right if the key at K is less than KEY. We
+     * prefetch the grandchildren of K, they are in two cache lines */
+    long k = 1;
+    while(k <= e->nitems) {
+        __builtin_prefetch(e->keys + 4*k);
+        k = 2*k + (eytz_cmp(e->keys[k], key) < 0);
+    }
+
+    /* Cancel the right turns after the last left turn */
+    k >>= __builtin_ffsl(~k);
+    return k;
+}
+
+/* eytz_first: get the position of the smallest term in sorted vocabulary E.
+ * It returns 0 if E is empty */
+long eytz_first(struct eytz *e)
+{
+    if(e->nitems == 0) return 0;
+
+    long k = 1;
+    while(2*k <= e->nitems) k = 2*k;
+    return k;
+}
+
+/* eytz_next: get the position of the term after the term at position K in
+ * alphabetical order. It returns 0 if K is the last term */
+long eytz_next(struct eytz *e, long k)
+{
+    /* Go to the smallest term of the right subtree */
+    if(2*k + 1 <= e->nitems) {
+        k = 2*k + 1;
+        while(2*k <= e->nitems) k = 2*k;
+        return k;
+    }
+
+    /* Otherwise go up until we come from the left child */
+    while(k & 1) k >>= 1;
+    return k >> 1;
+}
+
+/* eytz_print: print each term in sorted vocabulary E in alphabetical order */
+void eytz_print(struct eytz *e)
+{
+    long k;
+    for(k = eytz_first(e); k != 0; k = eytz_next(e, k)) {
+        printf("%li:%d:%s\n", e->indexes[k], e->ndocs[k], e->keys[k]);
+    }
+}
+
+/* eytz_print_prefix: print each term in sorted vocabulary E that starts with
+ * PREFIX in alphabetical order. It returns the number of printed terms */
+long eytz_print_prefix(struct eytz *e, char *prefix)
+{
+    size_t len = strlen(prefix);
+    long k, n = 0;
+    for(k = eytz_lower_bound(e, prefix); k != 0; k = eytz_next(e, k)) {
+        if(strncmp(e->keys[k], prefix, len) != 0) break;
+        printf("%li:%d:%s\n", e->indexes[k], e->ndocs[k], e->keys[k]);
+        n += 1;
+    }
+    return n;
+}
+
+/* eytz_destroy: remove sorted vocabulary E from memory */
+void eytz_destroy(struct eytz *e)
+{
+    if(e == NULL) return;
+    free(e->keys);
+    free(e->indexes);
+    free(e->ndocs);
+    free(e);
+}
@@ -0,0 +1,57 @@
+/* Sayoeti Sorted Vocabulary
+ * Read-only ordered layout of the dictionary for the prefix queries of
+ * --terms and the deterministic dump of the index vocabulary under --debug.
+ * The AVL tree of the dictionary is flattened into breadth-first
+ * (Eytzinger) order, so the binary search walks the array from the top and
+ * the next levels can be prefetched, and the terms are walked in
+ * alphabetical order without recursion.
+ *
+ * Each term is stored as fixed width key padded with zeroes; a term have
+ * at most MAX_TOKEN_CHAR-1 characters so one key fits in 32 bytes and it
+ * can be compared with two 16-byte SIMD compares instead of strcmp.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EYTZ_H
+#define EYTZ_H
+
+/* Macros */
+#define EYTZ_KEY_SIZE 32
+
+/* eytz: represents the sorted vocabulary. Position 0 is not used; the
+ * children of position K are 2K and 2K+1. */
+struct eytz {
+    /* Number of terms */
+    long nitems;
+
+    /* Zero padded terms in Eytzinger order */
+    char (*keys)[EYTZ_KEY_SIZE];
+
+    /* Index and number of documents of the term in each position */
+    long *indexes;
+    int *ndocs;
+};
+
+/* Prototypes */
+struct eytz *eytz_build(struct dict *d);
+long eytz_lower_bound(struct eytz *e, char *term);
+long eytz_first(struct eytz *e);
+long eytz_next(struct eytz *e, long k);
+void eytz_print(struct eytz *e);
+long eytz_print_prefix(struct eytz *e, char *prefix);
+void eytz_destroy(struct eytz *e);
+
+#endif
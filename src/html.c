@@ -0,0 +1,361 @@
+/* Sayoeti HTML Scrubber
+ * Turn the raw HTML of one request into plain text before tokenization.
+ * The buffer is scrubbed in place in one pass: the tags are replaced by a
+ * space, the comments, scripts and styles are removed and the entities are
+ * decoded. The runs of plain text are found with 16-byte SIMD compares.
+ *
+ * Optionally only the main content is kept. The page is split into blocks
+ * at the block-level tags; a block is kept if it has enough text per tag
+ * and not too much of its text is inside links, so the navigation menus,
+ * the related links and the footers are dropped. The navigation, header,
+ * footer, aside and form elements are dropped as a whole; one that is
+ * never closed ends at the next article, main or body tag, so it can't
+ * drop the rest of the page.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "html.h"
+
+/* html_block: state of the current block of the main content */
+struct html_block {
+    /* Start of the block in the output */
+    int start;
+
+    /* Characters of text, characters of text inside links and the number
+     * of inline tags of the block */
+    int ntext;
+    int nlink;
+    int ntags;
+
+    /* The block is a heading; the headline is short but it's the content */
+    int is_heading;
+
+    /* The text is inside a link */
+    int inlink;
+};
+
+/* html_scan: get the length of the plain text run at P of at most N
+ * characters; the run stops at '<', '&' or '\r' */
+static int html_scan(const char *p, int n)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for(; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, lt), _mm_cmpeq_epi8(x, amp)),
+                                 _mm_cmpeq_epi8(x, cr));
+        int mask = _mm_movemask_epi8(m);
+        if(mask) return i + __builtin_ctz(mask);
+    }
+#endif
+    for(; i < n; i++) {
+        if(p[i] == '<' || p[i] == '&' || p[i] == '\r') break;
+    }
+    return i;
+}
+
+/* html_is: check wether the tag name NAME is one of the names in the NULL
+ * terminated list NAMES */
+static int html_is(const char *name, const char **names)
+{
+    for(; *names; names++) {
+        if(strcmp(name, *names) == 0) return 1;
+    }
+    return 0;
+}
+
+/* The content of these elements is not text */
+static const char *html_raw[] = {"script", "style", "noscript", "template", NULL};
+
+/* These elements end the current block */
+static const char *html_blocks[] = {
+    "p", "div", "li", "ul", "ol", "td", "th", "tr", "table", "h1", "h2", "h3",
+    "h4", "h5", "h6", "article", "section", "main", "blockquote", "pre", "dd",
+    "dt", "body", "title", NULL
+};
+
+/* These elements hold the content; they end any boilerplate element left
+ * open */
+static const char *html_sections[] = {"article", "main", "body", NULL};
+
+/* These elements are never the main content */
+static const char *html_boilerplate[] = {
+    "nav", "header", "footer", "aside", "form", "menu", "select", "button", NULL
+};
+
+/* html_find_close: find the end of the closing tag of element NAME in
+ * BUFFER from index I up to END; the name is compared in lower case. It
+ * returns the index after the closing tag or END if it's not closed */
+static int html_find_close(const char *buffer, int i, int end, const char *name)
+{
+    size_t lenname = strlen(name);
+    while(i < end) {
+        const char *lt = memchr(buffer + i, '<', end - i);
+        if(lt == NULL) return end;
+        i = lt - buffer + 1;
+
+        if(i < end && buffer[i] == '/' && i + 1 + (int)lenname <= end &&
+           strncasecmp(buffer + i + 1, name, lenname) == 0 &&
+           !isalnum((unsigned char)buffer[i + 1 + lenname])) {
+            const char *gt = memchr(buffer + i, '>', end - i);
+            return gt ? gt - buffer + 1 : end;
+        }
+    }
+    return end;
+}
+
+/* html_skip_tag: find the end of the tag that starts at index I of BUFFER
+ * up to END; the quoted attribute values may contain '>'. It returns the
+ * index after the tag */
+static int html_skip_tag(const char *buffer, int i, int end)
+{
+    while(i < end && buffer[i] != '>') {
+        char c = buffer[i];
+        if(c == '"' || c == '\'') {
+            const char *q = memchr(buffer + i + 1, c, end - i - 1);
+            if(q == NULL) return end;
+            i = q - buffer;
+        }
+        i++;
+    }
+    return (i < end) ? i + 1 : end;
+}
+
+/* html_utf8: encode the code point CP in UTF-8 to OUT. It returns the
+ * number of bytes */
+static int html_utf8(char *out, long cp)
+{
+    if(cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if(cp < 0x800) {
+        out[0] = (char)(0xc0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if(cp < 0x10000) {
+        out[0] = (char)(0xe0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        out[2] = (char)(0x80 | (cp & 0x3f));
+        return 3;
+    }
+    out[0] = (char)(0xf0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+    out[3] = (char)(0x80 | (cp & 0x3f));
+    return 4;
+}
+
+/* html_entity: decode the entity that starts at index I of BUFFER up to
+ * END to OUT; the decoded text is never longer than the entity, so OUT may
+ * point inside BUFFER before I. The number of decoded bytes is saved to
+ * NOUT. It returns the index after the entity; a bare '&' is kept as is */
+static int html_entity(const char *buffer, int i, int end, char *out, int *nout)
+{
+    int j = i + 1;
+    long cp = -1;
+
+    if(j < end && buffer[j] == '#') {
+        /* Numeric entity; decimal or hexadecimal */
+        int base = 10;
+        j++;
+        if(j < end && (buffer[j] == 'x' || buffer[j] == 'X')) {
+            base = 16;
+            j++;
+        }
+        int start = j;
+        cp = 0;
+        while(j < end && j - start < 8 && (base == 16 ? isxdigit((unsigned char)buffer[j]) : isdigit((unsigned char)buffer[j]))) {
+            int c = tolower((unsigned char)buffer[j]);
+            cp = cp * base + (isdigit(c) ? c - '0' : c - 'a' + 10);
+            j++;
+        }
+        if(j == start) cp = -1;
+        if(cp == 0 || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) cp = ' ';
+    } else {
+        /* Named entity; only the ones that appear in the news text */
+        static const char *names[] = {"amp", "lt", "gt", "quot", "apos", "nbsp", NULL};
+        static const char chars[] = {'&', '<', '>', '"', '\'', ' '};
+        char name[8];
+        int n = 0;
+        while(j < end && n < 7 && isalnum((unsigned char)buffer[j])) {
+            name[n++] = buffer[j++];
+        }
+        name[n] = '\0';
+        int k;
+        for(k = 0; names[k]; k++) {
+            if(strcmp(name, names[k]) == 0) {
+                cp = (unsigned char)chars[k];
+                break;
+            }
+        }
+    }
+
+    if(cp < 0 || j >= end || buffer[j] != ';') {
+        /* Not an entity */
+        out[0] = '&';
+        *nout = 1;
+        return i + 1;
+    }
+    *nout = html_utf8(out, cp);
+    return j + 1;
+}
+
+/* html_block_end: end the block B of the output BUFFER that ends at index
+ * O; the block is dropped if it's boilerplate. It returns the new end of
+ * the output and B is ready for the next block */
+static int html_block_end(char *buffer, int o, struct html_block *b)
+{
+    if((!b->is_heading && b->ntext < HTML_MIN_DENSITY * (b->ntags + 1)) ||
+       b->nlink * 100 > b->ntext * HTML_MAX_LINK_PERCENT) {
+        o = b->start;
+    }
+    b->start = o;
+    b->ntext = 0;
+    b->nlink = 0;
+    b->ntags = 0;
+    b->is_heading = 0;
+    b->inlink = 0;
+    return o;
+}
+
+/* html_scrub: scrub the HTML in BUFFER of LENBUF characters terminated by
+ * '\r' to plain text in place; see html.h. If FLAGS has HTML_MAIN_CONTENT
+ * only the main content is kept. It returns the new length of the buffer
+ * including the terminator. The buffer without any tag is kept as is,
+ * except the entities */
+int html_scrub(char *buffer, int lenbuf, int flags)
+{
+    int end = lenbuf - 1;
+    int i = 0, o = 0;
+
+    /* State of the main content */
+    int is_main = flags & HTML_MAIN_CONTENT;
+    struct html_block b = {0, 0, 0, 0, 0, 0};
+    int ntags = 0, skip = 0;
+
+    while(i < end) {
+        /* Copy the plain text run */
+        int n = html_scan(buffer + i, end - i);
+        if(n > 0) {
+            if(!skip) {
+                memmove(buffer + o, buffer + i, n);
+                o += n;
+                b.ntext += n;
+                if(b.inlink) b.nlink += n;
+            }
+            i += n;
+            continue;
+        }
+
+        char c = buffer[i];
+        if(c == '&') {
+            int nout;
+            i = html_entity(buffer, i, end, buffer + o, &nout);
+            if(!skip) {
+                o += nout;
+                b.ntext += nout;
+                if(b.inlink) b.nlink += nout;
+            }
+            continue;
+        }
+        if(c == '\r') {
+            /* Only the last '\r' terminates the buffer */
+            if(!skip) buffer[o++] = ' ';
+            i++;
+            continue;
+        }
+
+        /* Comments and declarations */
+        if(i + 1 < end && (buffer[i+1] == '!' || buffer[i+1] == '?')) {
+            if(i + 3 < end && buffer[i+2] == '-' && buffer[i+3] == '-') {
+                int j = i + 4;
+                while(j + 2 < end && !(buffer[j] == '-' && buffer[j+1] == '-' && buffer[j+2] == '>')) j++;
+                i = (j + 2 < end) ? j + 3 : end;
+            } else {
+                i = html_skip_tag(buffer, i, end);
+            }
+            continue;
+        }
+
+        /* Tag name in lower case */
+        int j = i + 1;
+        int is_closing = (j < end && buffer[j] == '/');
+        if(is_closing) j++;
+        char name[HTML_MAX_NAME];
+        int lenname = 0;
+        while(j < end && isalnum((unsigned char)buffer[j])) {
+            if(lenname < HTML_MAX_NAME - 1) name[lenname++] = tolower((unsigned char)buffer[j]);
+            j++;
+        }
+        name[lenname] = '\0';
+
+        /* Not a tag; e.g. "a < b" */
+        if(lenname == 0) {
+            if(!skip) buffer[o++] = ' ';
+            i++;
+            continue;
+        }
+        i = html_skip_tag(buffer, j, end);
+        ntags++;
+
+        /* The tag separates the words */
+        if(!skip) buffer[o++] = ' ';
+
+        if(!is_closing && html_is(name, html_raw)) {
+            i = html_find_close(buffer, i, end, name);
+            continue;
+        }
+        if(!is_main) {
+            continue;
+        }
+
+        if(html_is(name, html_boilerplate)) {
+            /* The text of the block before is kept or dropped first */
+            if(!skip) o = html_block_end(buffer, o, &b);
+            skip += is_closing ? -1 : 1;
+            if(skip < 0) skip = 0;
+        } else if(skip && !html_is(name, html_sections)) {
+            continue;
+        } else if(html_is(name, html_blocks)) {
+            skip = 0;
+            o = html_block_end(buffer, o, &b);
+            b.is_heading = !is_closing && name[0] == 'h' && isdigit((unsigned char)name[1]);
+        } else {
+            if(strcmp(name, "a") == 0) b.inlink = !is_closing;
+            b.ntags++;
+        }
+    }
+
+    /* The last block; the plain text is not split into blocks at all */
+    if(is_main && ntags > 0) {
+        o = html_block_end(buffer, o, &b);
+    }
+
+    buffer[o] = '\r';
+    return o + 1;
+}
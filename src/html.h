@@ -0,0 +1,48 @@
+/* Sayoeti HTML Scrubber
+ * Turn the raw HTML of one request into plain text before tokenization.
+ * The buffer is scrubbed in place in one pass: the tags are replaced by a
+ * space, the comments, scripts and styles are removed and the entities are
+ * decoded. The runs of plain text are found with 16-byte SIMD compares.
+ *
+ * Optionally only the main content is kept. The page is split into blocks
+ * at the block-level tags; a block is kept if it has enough text per tag
+ * and not too much of its text is inside links, so the navigation menus,
+ * the related links and the footers are dropped. The navigation, header,
+ * footer, aside and form elements are dropped as a whole; one that is
+ * never closed ends at the next article, main or body tag, so it can't
+ * drop the rest of the page.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HTML_H
+#define HTML_H
+
+/* Macros */
+/* Keep only the main content of the page */
+#define HTML_MAIN_CONTENT 1
+/* Tag names longer than this are truncated; no tag we care about is */
+#define HTML_MAX_NAME 16
+/* A block is kept if it has at least this many characters of text per
+ * inline tag; the headings are always kept */
+#define HTML_MIN_DENSITY 24
+/* A block is dropped if more than this percent of its text is inside
+ * links */
+#define HTML_MAX_LINK_PERCENT 33
+
+/* Prototypes */
+int html_scrub(char *buffer, int lenbuf, int flags);
+
+#endif
@@ -0,0 +1,862 @@
+/* Sayoeti Predictor
+ * Read-only prediction engine of the trained one-class model for the
+ * serving phase. libsvm merges the query with every support vector; a
+ * short news query shares terms with only a few of them. So the support
+ * vectors are inverted into a posting list of (SV, value) for each term id
+ * and the dot products of the query with all support vectors are summed
+ * over the postings of the query terms only. The RBF kernel is then
+ * exp(-gamma*(|x|^2 + |sv|^2 - 2*x.sv)) with the squared norm of each
+ * support vector stored in the model. The distances to all support
+ * vectors are computed first and the exponentials are evaluated over the
+ * whole array with SIMD; the polynomial has a relative error below 1e-15.
+ *
+ * The label only needs the sign of sum(alpha_i*K(x, sv_i)) - rho and each
+ * term is in [0, alpha_i]. So the support vectors are numbered by
+ * descending alpha and the kernel is evaluated block by block; the sum so
+ * far is a lower bound and adding the remaining alpha mass gives an upper
+ * bound. The prediction stops as soon as the sign is certain; the
+ * decision value is still exact.
+ *
+ * A model with many support vectors can be split into contiguous shards,
+ * one for each thread of a team; each shard is a predictor of its own and
+ * the partial sums are added before rho is subtracted.
+ *
+ * With the LINEAR kernel the decision function is w.x - rho; the support
+ * vectors are folded into one dense weight array indexed by term id, so
+ * the prediction is one sparse-dense dot product. The models with the
+ * other kernels are predicted by libsvm with the buffers of the predictor,
+ * so the prediction never allocates.
+ *
+ * The RBF model can also be served approximately with D random Fourier
+ * frequencies: each column of W is drawn from N(0, 2*gamma) and
+ * z(x) = sqrt(1/D)*[cos(W.x), sin(W.x)], so K(x, sv) ~ z(x).z(sv). The
+ * paired cosine and sine have less variance than one cosine with a random
+ * phase. The support vectors are folded into one weight per feature and
+ * the prediction costs O(nnz*D) whatever the number of support vectors. W
+ * is drawn from a fixed seed by term id, so the columns of the terms that
+ * are in no support vector are drawn again when they are needed.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "predict.h"
+
+/* predictor_exp: replace each of the N values of X, none of them is
+ * positive, with its exponential. exp(x) = 2^k*exp(r) with |r| <= ln(2)/2
+ * and exp(r) is the Taylor polynomial of degree 12; the values below
+ * PREDICT_MIN_EXP become 0 */
+static void predictor_exp(double *x, int n)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128d log2e = _mm_set1_pd(1.4426950408889634);
+    const __m128d ln2hi = _mm_set1_pd(6.93145751953125e-1);
+    const __m128d ln2lo = _mm_set1_pd(1.42860682030941723212e-6);
+    const __m128d minx = _mm_set1_pd(PREDICT_MIN_EXP);
+    const __m128i bias = _mm_set1_epi32(1023);
+    for(; i + 2 <= n; i += 2) {
+        __m128d v = _mm_loadu_pd(x + i);
+        __m128d under = _mm_cmplt_pd(v, minx);
+        v = _mm_max_pd(v, minx);
+
+        /* k = round(x/ln(2)) and r = x - k*ln(2) in two steps */
+        __m128i k = _mm_cvtpd_epi32(_mm_mul_pd(v, log2e));
+        __m128d kd = _mm_cvtepi32_pd(k);
+        __m128d r = _mm_sub_pd(_mm_sub_pd(v, _mm_mul_pd(kd, ln2hi)), _mm_mul_pd(kd, ln2lo));
+
+        __m128d y = _mm_set1_pd(1.0 / 479001600);
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 39916800));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 3628800));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 362880));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 40320));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 5040));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 720));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 120));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 24));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0 / 6));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(0.5));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0));
+        y = _mm_add_pd(_mm_mul_pd(y, r), _mm_set1_pd(1.0));
+
+        /* 2^k from the exponent bits; k + 1023 is never below 1 */
+        __m128i e = _mm_unpacklo_epi32(_mm_add_epi32(k, bias), _mm_setzero_si128());
+        __m128d scale = _mm_castsi128_pd(_mm_slli_epi64(e, 52));
+        y = _mm_andnot_pd(under, _mm_mul_pd(y, scale));
+        _mm_storeu_pd(x + i, y);
+    }
+#endif
+    for(; i < n; i++) {
+        x[i] = (x[i] < PREDICT_MIN_EXP) ? 0 : exp(x[i]);
+    }
+}
+
+/* predictor_sum: get the dot product of the N values of A and B */
+static double predictor_sum(const double *a, const double *b, int n)
+{
+    int i = 0;
+    double sum = 0;
+#ifdef __SSE2__
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for(; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    sum = lanes[0] + lanes[1];
+#endif
+    for(; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/* predictor_cmp: order the pairs of (SV, coefficient) A and B by
+ * descending coefficient, then by SV; used by qsort */
+static int predictor_cmp(const void *a, const void *b)
+{
+    const struct predict_posting *pa = (const struct predict_posting *)a;
+    const struct predict_posting *pb = (const struct predict_posting *)b;
+    if(pa->value > pb->value) return -1;
+    if(pa->value < pb->value) return 1;
+    return pa->sv - pb->sv;
+}
+
+/* predictor_range: build the prediction engine of the support vectors
+ * from FIRST up to LAST of the model MODEL; the kernel must be RBF or
+ * LINEAR. Returns NULL if only if error happen and ERRNO will be set to
+ * last error. */
+static struct predictor *predictor_range(const struct svm_model *model, int first, int last)
+{
+    struct predictor *p = (struct predictor *)calloc(1, sizeof(struct predictor));
+    if(p == NULL) {
+        return NULL;
+    }
+    p->model = model;
+    p->l = last - first;
+    p->gamma = model->param.gamma;
+    p->rho = model->rho[0];
+    p->is_linear = (model->param.kernel_type == LINEAR);
+
+    /* The support vectors of the range */
+    struct svm_node **svs = model->SV + first;
+    const double *svcoefs = model->sv_coef[0] + first;
+
+    /* The biggest term id and the number of postings */
+    long npostings = 0;
+    int i;
+    for(i = 0; i < p->l; i++) {
+        const struct svm_node *node;
+        for(node = svs[i]; node->index != -1; node++) {
+            if(node->index >= p->nids) p->nids = node->index + 1;
+            npostings++;
+        }
+    }
+
+    /* The linear decision function is w.x - rho; fold the support
+     * vectors into w */
+    if(p->is_linear) {
+        p->weights = (float *)calloc(p->nids + 1, sizeof(float));
+        if(p->weights == NULL) {
+            predictor_destroy(p);
+            return NULL;
+        }
+        for(i = 0; i < p->l; i++) {
+            const struct svm_node *node;
+            for(node = svs[i]; node->index != -1; node++) {
+                p->weights[node->index] += (float)(svcoefs[i] * node->value);
+            }
+        }
+        return p;
+    }
+    long ndots = (p->l > PREDICT_TILE * PREDICT_BATCH) ? p->l : PREDICT_TILE * PREDICT_BATCH;
+    p->dots = (double *)malloc((ndots + 1) * sizeof(double));
+    p->rows = (double *)malloc(PREDICT_BATCH * PREDICT_BLOCK * sizeof(double));
+    p->coefs = (double *)malloc((p->l + 1) * sizeof(double));
+    p->norms = (double *)malloc((p->l + 1) * sizeof(double));
+    p->order = (int *)malloc((p->l + 1) * sizeof(int));
+    p->masses = (double *)malloc((p->l + 1) * sizeof(double));
+    if(p->dots == NULL || p->rows == NULL || p->coefs == NULL || p->norms == NULL || p->order == NULL ||
+       p->masses == NULL) {
+        predictor_destroy(p);
+        return NULL;
+    }
+
+    /* Number the support vectors by descending coefficient; the pairs of
+     * (SV, coefficient) are sorted in the posting array before it's
+     * filled */
+    long npairs = (npostings > p->l) ? npostings : p->l;
+    p->postings = (struct predict_posting *)malloc((npairs + 1) * sizeof(struct predict_posting));
+    if(p->postings == NULL) {
+        predictor_destroy(p);
+        return NULL;
+    }
+    for(i = 0; i < p->l; i++) {
+        p->postings[i].sv = first + i;
+        p->postings[i].value = svcoefs[i];
+    }
+    qsort(p->postings, p->l, sizeof(struct predict_posting), predictor_cmp);
+    for(i = 0; i < p->l; i++) {
+        p->order[i] = p->postings[i].sv;
+        p->coefs[i] = model->sv_coef[0][p->order[i]];
+        if(model->sv_square) {
+            p->norms[i] = model->sv_square[p->order[i]];
+            continue;
+        }
+        /* The model couldn't keep the squared norms */
+        const struct svm_node *node;
+        p->norms[i] = 0;
+        for(node = model->SV[p->order[i]]; node->index != -1; node++) {
+            p->norms[i] += node->value * node->value;
+        }
+    }
+    p->masses[p->l] = 0;
+    for(i = p->l - 1; i >= 0; i--) {
+        p->masses[i] = p->masses[i + 1] + p->coefs[i];
+    }
+
+    /* Count the postings of each id, then fill them in SV order by
+     * descending coefficient */
+    p->starts = (long *)calloc(p->nids + 1, sizeof(long));
+    p->heads = (int *)malloc((p->nids + 1) * sizeof(int));
+    if(p->starts == NULL || p->heads == NULL) {
+        predictor_destroy(p);
+        return NULL;
+    }
+    for(i = 0; i <= p->nids; i++) {
+        p->heads[i] = -1;
+    }
+    for(i = 0; i < p->l; i++) {
+        const struct svm_node *node;
+        for(node = svs[i]; node->index != -1; node++) {
+            p->starts[node->index + 1] += 1;
+        }
+    }
+    int id;
+    for(id = 0; id < p->nids; id++) {
+        p->starts[id + 1] += p->starts[id];
+    }
+    long *fill = (long *)malloc((p->nids + 1) * sizeof(long));
+    if(fill == NULL) {
+        predictor_destroy(p);
+        return NULL;
+    }
+    memcpy(fill, p->starts, (p->nids + 1) * sizeof(long));
+    int rank;
+    for(rank = 0; rank < p->l; rank++) {
+        const struct svm_node *node;
+        for(node = model->SV[p->order[rank]]; node->index != -1; node++) {
+            struct predict_posting *post = &p->postings[fill[node->index]++];
+            post->sv = rank;
+            post->value = node->value;
+        }
+    }
+    free(fill);
+
+    return p;
+}
+
+/* predictor_new: build the prediction engine of the model MODEL. Only the
+ * ONE_CLASS model is supported; the precomputed kernel is not. Returns
+ * NULL if only if error happen and ERRNO will be set to last error. */
+struct predictor *predictor_new(const struct svm_model *model)
+{
+    if(model->param.svm_type != ONE_CLASS || model->param.kernel_type == PRECOMPUTED) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if(model->param.kernel_type == RBF || model->param.kernel_type == LINEAR) {
+        return predictor_range(model, 0, model->l);
+    }
+
+    /* The other kernels aren't inverted; libsvm predicts with the scratch
+     * of the predictor */
+    struct predictor *p = (struct predictor *)calloc(1, sizeof(struct predictor));
+    if(p == NULL) {
+        return NULL;
+    }
+    p->model = model;
+    p->l = model->l;
+    p->rho = model->rho[0];
+    p->scratch = svm_scratch_create(model);
+    if(p->scratch == NULL) {
+        free(p);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return p;
+}
+
+/* predictor_parallel: build the prediction engine of the model MODEL that
+ * splits the support vectors into one contiguous shard for each thread of
+ * TEAM; the shards are evaluated at once and their sums are added. Only
+ * the ONE_CLASS model with RBF kernel is supported. Returns NULL if only
+ * if error happen and ERRNO will be set to last error. */
+struct predictor *predictor_parallel(const struct svm_model *model, struct team *team)
+{
+    if(model->param.svm_type != ONE_CLASS || model->param.kernel_type != RBF) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct predictor *p = (struct predictor *)calloc(1, sizeof(struct predictor));
+    if(p == NULL) {
+        return NULL;
+    }
+    p->model = model;
+    p->l = model->l;
+    p->gamma = model->param.gamma;
+    p->rho = model->rho[0];
+    p->team = team;
+    p->nshards = team->nthreads;
+    p->shards = (struct predictor **)calloc(p->nshards, sizeof(struct predictor *));
+    p->partials = (double *)calloc(p->nshards, sizeof(double));
+    if(p->shards == NULL || p->partials == NULL) {
+        predictor_destroy(p);
+        return NULL;
+    }
+
+    /* The rho is subtracted once from the sum of the shards */
+    int k;
+    for(k = 0; k < p->nshards; k++) {
+        int first = (int)((long)p->l * k / p->nshards);
+        int last = (int)((long)p->l * (k + 1) / p->nshards);
+        p->shards[k] = predictor_range(model, first, last);
+        if(p->shards[k] == NULL) {
+            predictor_destroy(p);
+            return NULL;
+        }
+        p->shards[k]->rho = 0;
+    }
+
+    return p;
+}
+
+/* predictor_reserve: make room for N batch entries and groups in
+ * predictor P. Returns -1 if only if error happen and ERRNO will be set
+ * to last error. */
+static int predictor_reserve(struct predictor *p, int n)
+{
+    if(n <= p->maxentries) return 0;
+    int maxentries = p->maxentries ? p->maxentries : 256;
+    while(maxentries < n) maxentries *= 2;
+    struct predict_entry *entries = (struct predict_entry *)realloc(p->entries,
+        maxentries * sizeof(struct predict_entry));
+    if(entries == NULL) {
+        return -1;
+    }
+    p->entries = entries;
+    struct predict_group *groups = (struct predict_group *)realloc(p->groups,
+        maxentries * sizeof(struct predict_group));
+    if(groups == NULL) {
+        return -1;
+    }
+    p->groups = groups;
+    p->maxentries = maxentries;
+    return 0;
+}
+
+/* predictor_mix: next value of the splitmix64 generator of state S */
+static uint64_t predictor_mix(uint64_t *s)
+{
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* predictor_uniform: uniform number in (0, 1) from state S */
+static double predictor_uniform(uint64_t *s)
+{
+    return ((predictor_mix(s) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/* predictor_rff_column: draw the column of W of term id ID of predictor
+ * P to COLUMN; the values are N(0, 2*gamma) */
+static void predictor_rff_column(struct predictor *p, int id, float *column)
+{
+    uint64_t s = PREDICT_RFF_SEED ^ ((uint64_t)id * 0xd1b54a32d192ed03ULL);
+    int d;
+
+    /* Box-Muller; two normal numbers from two uniform numbers */
+    double scale = sqrt(2 * p->gamma);
+    for(d = 0; d < p->ndims; d += 2) {
+        double r = sqrt(-2 * log(predictor_uniform(&s)));
+        double t = 2 * M_PI * predictor_uniform(&s);
+        column[d] = (float)(scale * r * cos(t));
+        if(d + 1 < p->ndims) column[d + 1] = (float)(scale * r * sin(t));
+    }
+}
+
+/* predictor_rff_project: save W.x of the query X to the projection of
+ * predictor P */
+static void predictor_rff_project(struct predictor *p, const struct svm_node *x)
+{
+    int d, nd = p->ndims;
+    memset(p->proj, 0, nd * sizeof(double));
+
+    const struct svm_node *node;
+    for(node = x; node->index != -1; node++) {
+        const float *column;
+        if(node->index > 0 && node->index < p->nids) {
+            column = p->omega + (long)node->index * nd;
+        } else {
+            predictor_rff_column(p, node->index, p->column);
+            column = p->column;
+        }
+        double value = node->value;
+        for(d = 0; d < nd; d++) {
+            p->proj[d] += value * column[d];
+        }
+    }
+}
+
+/* predictor_rff_limit: returns the maximum number of the random Fourier
+ * frequencies whose columns of the term ids below NIDS fit in
+ * PREDICT_MAX_RFF_BYTES; 0 if not even one frequency fits */
+int predictor_rff_limit(long nids)
+{
+    long limit = PREDICT_MAX_RFF_BYTES / ((nids + 1) * (long)sizeof(float));
+    return limit > PREDICT_MAX_RFF ? PREDICT_MAX_RFF : (int)limit;
+}
+
+/* predictor_rff: build the approximate prediction engine of the model
+ * MODEL with NDIMS random Fourier frequencies. Only the ONE_CLASS model with
+ * RBF kernel is supported. Returns NULL if only if error happen and ERRNO
+ * will be set to last error; E2BIG if the columns of NDIMS frequencies
+ * don't fit in PREDICT_MAX_RFF_BYTES. */
+struct predictor *predictor_rff(const struct svm_model *model, int ndims)
+{
+    if(model->param.svm_type != ONE_CLASS || model->param.kernel_type != RBF ||
+       ndims < 1 || ndims > PREDICT_MAX_RFF) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct predictor *p = (struct predictor *)calloc(1, sizeof(struct predictor));
+    if(p == NULL) {
+        return NULL;
+    }
+    p->model = model;
+    p->l = model->l;
+    p->gamma = model->param.gamma;
+    p->rho = model->rho[0];
+    p->ndims = ndims;
+
+    /* The columns of the terms of the support vectors are kept */
+    int i;
+    for(i = 0; i < p->l; i++) {
+        const struct svm_node *node;
+        for(node = model->SV[i]; node->index != -1; node++) {
+            if(node->index >= p->nids) p->nids = node->index + 1;
+        }
+    }
+    if(ndims > predictor_rff_limit(p->nids)) {
+        predictor_destroy(p);
+        errno = E2BIG;
+        return NULL;
+    }
+    p->omega = (float *)malloc((long)(p->nids + 1) * ndims * sizeof(float));
+    p->coswts = (double *)calloc(ndims, sizeof(double));
+    p->sinwts = (double *)calloc(ndims, sizeof(double));
+    p->proj = (double *)malloc(ndims * sizeof(double));
+    p->column = (float *)malloc(ndims * sizeof(float));
+    if(p->omega == NULL || p->coswts == NULL || p->sinwts == NULL || p->proj == NULL || p->column == NULL) {
+        predictor_destroy(p);
+        return NULL;
+    }
+    int id;
+    for(id = 1; id < p->nids; id++) {
+        predictor_rff_column(p, id, p->omega + (long)id * ndims);
+    }
+
+    /* Fold the support vectors: the weights of frequency D are
+     * 1/D * sum(alpha_i * cos(W_d.sv_i)) and the same with sine */
+    int d;
+    for(i = 0; i < p->l; i++) {
+        predictor_rff_project(p, model->SV[i]);
+        for(d = 0; d < ndims; d++) {
+            p->coswts[d] += model->sv_coef[0][i] * cos(p->proj[d]);
+            p->sinwts[d] += model->sv_coef[0][i] * sin(p->proj[d]);
+        }
+    }
+    for(d = 0; d < ndims; d++) {
+        p->coswts[d] /= ndims;
+        p->sinwts[d] /= ndims;
+    }
+
+    return p;
+}
+
+/* predictor_rbf_dots: save the dot product of the query X with each
+ * support vector of predictor P to its scratch. It returns the squared
+ * norm of X */
+static double predictor_rbf_dots(struct predictor *p, const struct svm_node *x)
+{
+    /* Accumulate the dot products over the postings of the query terms;
+     * the terms that are in no support vector only add to the norm */
+    memset(p->dots, 0, p->l * sizeof(double));
+    double norm = 0;
+    const struct svm_node *node;
+    for(node = x; node->index != -1; node++) {
+        norm += node->value * node->value;
+        if(node->index < 0 || node->index >= p->nids) continue;
+
+        const struct predict_posting *post = p->postings + p->starts[node->index];
+        const struct predict_posting *last = p->postings + p->starts[node->index + 1];
+        for(; post < last; post++) {
+            p->dots[post->sv] += node->value * post->value;
+        }
+    }
+    return norm;
+}
+
+/* predictor_rbf_sum: get the sum of coef*K(x, sv) of the support vectors
+ * from FIRST up to LAST of predictor P; the dot products with the query
+ * of squared norm NORM are DOTS[0] up to DOTS[LAST-FIRST] and are
+ * overwritten */
+static double predictor_rbf_sum(struct predictor *p, double *dots, double norm, int first, int last)
+{
+    /* The squared distance can't be negative; the rounding can */
+    double sum = 0;
+    int i, n = last - first;
+    const double *coefs = p->coefs + first;
+    const double *norms = p->norms + first;
+    if(p->is_scalar) {
+        for(i = 0; i < n; i++) {
+            double d = norm + norms[i] - 2 * dots[i];
+            if(d < 0) d = 0;
+            sum += coefs[i] * exp(-p->gamma * d);
+        }
+        return sum;
+    }
+
+    /* -gamma times the distances, then the kernel values in place */
+    for(i = 0; i < n; i++) {
+        double d = norm + norms[i] - 2 * dots[i];
+        dots[i] = (d < 0) ? 0 : -p->gamma * d;
+    }
+    predictor_exp(dots, n);
+    return predictor_sum(coefs, dots, n);
+}
+
+/* predictor_shard_run: get the sum of the shard K of predictor ARG for
+ * its query; the job of the thread pool */
+static void predictor_shard_run(void *arg, int k)
+{
+    struct predictor *p = (struct predictor *)arg;
+    p->partials[k] = predictor_decision(p->shards[k], p->query);
+}
+
+/* predictor_decision: get the value of the decision function of predictor
+ * P for the query X terminated by index -1 */
+double predictor_decision(struct predictor *p, const struct svm_node *x)
+{
+    const struct svm_node *node;
+    if(p->nshards) {
+        p->query = x;
+        team_run(p->team, predictor_shard_run, p);
+        double sum = 0;
+        int k;
+        for(k = 0; k < p->nshards; k++) {
+            sum += p->partials[k];
+        }
+        p->nevals = p->l;
+        return sum - p->rho;
+    }
+    if(p->scratch) {
+        double decision;
+        svm_predict_into(p->model, x, p->scratch, &decision);
+        p->nevals = p->l;
+        return decision;
+    }
+    if(p->is_linear) {
+        double sum = 0;
+        for(node = x; node->index != -1; node++) {
+            if(node->index < 0 || node->index >= p->nids) continue;
+            sum += node->value * p->weights[node->index];
+        }
+        return sum - p->rho;
+    }
+    if(p->ndims) {
+        predictor_rff_project(p, x);
+        double sum = 0;
+        int d;
+        for(d = 0; d < p->ndims; d++) {
+            sum += p->coswts[d] * cos(p->proj[d]) + p->sinwts[d] * sin(p->proj[d]);
+        }
+        return sum - p->rho;
+    }
+
+    double norm = predictor_rbf_dots(p, x);
+    double sum = predictor_rbf_sum(p, p->dots, norm, 0, p->l);
+    p->nevals = p->l;
+    return sum - p->rho;
+}
+
+/* predictor_rbf_label: get the label of the query of squared norm NORM
+ * whose dot products with the support vectors of predictor P are in DOTS.
+ * It stops as soon as the sign of the decision value is certain and the
+ * number of the evaluated support vectors is added to NEVALS */
+static double predictor_rbf_label(struct predictor *p, double *dots, double norm)
+{
+    /* The sum so far is the lower bound of the decision value; each of
+     * the remaining kernel values is at most 1 */
+    double sum = 0;
+    int first;
+    for(first = 0; first < p->l; first += PREDICT_BLOCK) {
+        int last = (first + PREDICT_BLOCK < p->l) ? first + PREDICT_BLOCK : p->l;
+        sum += predictor_rbf_sum(p, dots + first, norm, first, last);
+        if(sum - p->rho > 0 || sum + p->masses[last] - p->rho <= 0) {
+            p->nevals += last;
+            return (sum - p->rho > 0) ? 1 : -1;
+        }
+    }
+    p->nevals += p->l;
+    return (sum - p->rho > 0) ? 1 : -1;
+}
+
+/* predictor_predict: predict the label of the query X like svm_predict;
+ * it returns 1 if X is in the class, otherwise -1. With the RBF kernel it
+ * stops as soon as the sign of the decision value is certain, except with
+ * the shards; each of them sums all its support vectors */
+double predictor_predict(struct predictor *p, const struct svm_node *x)
+{
+    if(p->is_linear || p->ndims || p->nshards || p->scratch) {
+        return (predictor_decision(p, x) > 0) ? 1 : -1;
+    }
+
+    double norm = predictor_rbf_dots(p, x);
+    p->nevals = 0;
+    return predictor_rbf_label(p, p->dots, norm);
+}
+
+/* predictor_predict_batch: predict the labels of the N queries XS to OUT
+ * like predictor_predict. The kernels that aren't inverted are predicted
+ * by svm_predict_batch. With the RBF kernel the queries are taken
+ * PREDICT_BATCH at a time and the support vectors PREDICT_TILE at a time;
+ * the postings of each term of the batch are read once for all of its
+ * queries and the dot products of one tile stay in cache. No posting
+ * after the tile where the sign of every query is certain is read */
+void predictor_predict_batch(struct predictor *p, struct svm_node **xs, int n, double *out)
+{
+    int q, nevals = 0;
+    if(p->scratch && svm_predict_batch(p->model, xs, n, out) == 0) {
+        p->nevals = n * p->l;
+        return;
+    }
+    if(p->is_linear || p->ndims || p->nshards || p->scratch) {
+        for(q = 0; q < n; q++) {
+            out[q] = predictor_predict(p, xs[q]);
+            nevals += p->nevals;
+        }
+        p->nevals = nevals;
+        return;
+    }
+
+    p->nevals = 0;
+    int q0;
+    for(q0 = 0; q0 < n; q0 += PREDICT_BATCH) {
+        int nq = (q0 + PREDICT_BATCH < n) ? PREDICT_BATCH : n - q0;
+
+        /* Link the values of each term in the batch */
+        int nentries = 0;
+        const struct svm_node *node;
+        for(q = 0; q < nq; q++) {
+            for(node = xs[q0 + q]; node->index != -1; node++) nentries++;
+        }
+        if(predictor_reserve(p, nentries) != 0) {
+            /* No memory for the batch; predict the rest one by one */
+            nevals = p->nevals;
+            for(q = q0; q < n; q++) {
+                out[q] = predictor_predict(p, xs[q]);
+                nevals += p->nevals;
+            }
+            p->nevals = nevals;
+            return;
+        }
+        double norms[PREDICT_BATCH];
+        nentries = 0;
+        for(q = 0; q < nq; q++) {
+            norms[q] = 0;
+            for(node = xs[q0 + q]; node->index != -1; node++) {
+                norms[q] += node->value * node->value;
+                if(node->index < 0 || node->index >= p->nids) continue;
+                struct predict_entry *e = &p->entries[nentries];
+                e->id = node->index;
+                e->q = q;
+                e->value = node->value;
+                e->next = p->heads[node->index];
+                p->heads[node->index] = nentries++;
+            }
+        }
+
+        /* One group for each term with its queries; the head is reset
+         * once the group is made, so the next entry of the same term
+         * skips it. A query has each term once, so there are at most NQ
+         * queries in a group */
+        int k, ngroups = 0;
+        for(k = 0; k < nentries; k++) {
+            int id = p->entries[k].id;
+            if(p->heads[id] == -1) continue;
+
+            struct predict_group *g = &p->groups[ngroups++];
+            g->cursor = p->starts[id];
+            g->last = p->starts[id + 1];
+            g->nqs = 0;
+            int j;
+            for(j = p->heads[id]; j != -1 && g->nqs < nq; j = p->entries[j].next) {
+                g->qs[g->nqs] = p->entries[j].q;
+                g->values[g->nqs++] = p->entries[j].value;
+            }
+            p->heads[id] = -1;
+        }
+
+        double sums[PREDICT_BATCH];
+        int nleft = nq;
+        for(q = 0; q < nq; q++) {
+            sums[q] = 0;
+            out[q0 + q] = 0;
+        }
+
+        int s0;
+        for(s0 = 0; s0 < p->l && nleft > 0; s0 += PREDICT_TILE) {
+            int s1 = (s0 + PREDICT_TILE < p->l) ? s0 + PREDICT_TILE : p->l;
+
+            /* The dot products of support vector I of the tile with query
+             * Q are DOTS[(I-S0)*NQ+Q]; the postings of each term are
+             * ordered by support vector */
+            memset(p->dots, 0, (long)(s1 - s0) * nq * sizeof(double));
+            int g;
+            for(g = 0; g < ngroups; g++) {
+                struct predict_group *grp = &p->groups[g];
+                const struct predict_posting *post = p->postings + grp->cursor;
+                const struct predict_posting *last = p->postings + grp->last;
+                if(grp->nqs == 1) {
+                    double *dots = p->dots + grp->qs[0];
+                    double value = grp->values[0];
+                    for(; post < last && post->sv < s1; post++) {
+                        dots[(long)(post->sv - s0) * nq] += value * post->value;
+                    }
+                } else {
+                    for(; post < last && post->sv < s1; post++) {
+                        double *dots = p->dots + (long)(post->sv - s0) * nq;
+                        int j;
+                        for(j = 0; j < grp->nqs; j++) {
+                            dots[grp->qs[j]] += grp->values[j] * post->value;
+                        }
+                    }
+                }
+                grp->cursor = post - p->postings;
+            }
+
+            /* The sum so far is the lower bound of the decision value;
+             * each of the remaining kernel values is at most 1 */
+            int first;
+            for(first = s0; first < s1 && nleft > 0; first += PREDICT_BLOCK) {
+                int last = (first + PREDICT_BLOCK < s1) ? first + PREDICT_BLOCK : s1;
+                for(q = 0; q < nq; q++) {
+                    if(out[q0 + q] != 0) continue;
+                    double *row = p->rows + q * PREDICT_BLOCK;
+                    int i;
+                    for(i = first; i < last; i++) {
+                        row[i - first] = p->dots[(long)(i - s0) * nq + q];
+                    }
+                    sums[q] += predictor_rbf_sum(p, row, norms[q], first, last);
+                    if(sums[q] - p->rho > 0 || sums[q] + p->masses[last] - p->rho <= 0 || last == p->l) {
+                        out[q0 + q] = (sums[q] - p->rho > 0) ? 1 : -1;
+                        p->nevals += last;
+                        nleft--;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* predictor_scalar_exp: evaluate the RBF kernel of predictor P and its
+ * shards with exp(3) one by one instead of the SIMD exponential */
+void predictor_scalar_exp(struct predictor *p)
+{
+    p->is_scalar = 1;
+    int k;
+    for(k = 0; k < p->nshards; k++) {
+        predictor_scalar_exp(p->shards[k]);
+    }
+}
+
+/* predictor_agreement: compare the approximate predictor APPROX with the
+ * exact predictor EXACT on the N queries XS. The mean and the maximum of
+ * the absolute difference of the decision values are saved to MEANERR
+ * and MAXERR. It returns the fraction of the queries with the same label */
+double predictor_agreement(struct predictor *exact, struct predictor *approx, struct svm_node **xs, int n,
+    double *meanerr, double *maxerr)
+{
+    int i, nsame = 0;
+    double sumerr = 0;
+    *maxerr = 0;
+    for(i = 0; i < n; i++) {
+        double de = predictor_decision(exact, xs[i]);
+        double da = predictor_decision(approx, xs[i]);
+        if((de > 0) == (da > 0)) nsame++;
+        double err = fabs(de - da);
+        sumerr += err;
+        if(err > *maxerr) *maxerr = err;
+    }
+    *meanerr = n ? sumerr / n : 0;
+    return n ? (double)nsame / n : 1;
+}
+
+/* predictor_destroy: remove predictor P from memory */
+void predictor_destroy(struct predictor *p)
+{
+    if(p == NULL) return;
+    if(p->shards) {
+        int k;
+        for(k = 0; k < p->nshards; k++) {
+            predictor_destroy(p->shards[k]);
+        }
+        free(p->shards);
+    }
+    free(p->partials);
+    svm_scratch_free(p->scratch);
+    free(p->weights);
+    free(p->omega);
+    free(p->coswts);
+    free(p->sinwts);
+    free(p->proj);
+    free(p->column);
+    free(p->dots);
+    free(p->coefs);
+    free(p->norms);
+    free(p->order);
+    free(p->masses);
+    free(p->rows);
+    free(p->heads);
+    free(p->entries);
+    free(p->groups);
+    free(p->starts);
+    free(p->postings);
+    free(p);
+}
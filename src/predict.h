@@ -0,0 +1,194 @@
+/* Sayoeti Predictor
+ * Read-only prediction engine of the trained one-class model for the
+ * serving phase. libsvm merges the query with every support vector; a
+ * short news query shares terms with only a few of them. So the support
+ * vectors are inverted into a posting list of (SV, value) for each term id
+ * and the dot products of the query with all support vectors are summed
+ * over the postings of the query terms only. The RBF kernel is then
+ * exp(-gamma*(|x|^2 + |sv|^2 - 2*x.sv)) with the squared norm of each
+ * support vector stored in the model. The distances to all support
+ * vectors are computed first and the exponentials are evaluated over the
+ * whole array with SIMD; the polynomial has a relative error below 1e-15.
+ *
+ * The label only needs the sign of sum(alpha_i*K(x, sv_i)) - rho and each
+ * term is in [0, alpha_i]. So the support vectors are numbered by
+ * descending alpha and the kernel is evaluated block by block; the sum so
+ * far is a lower bound and adding the remaining alpha mass gives an upper
+ * bound. The prediction stops as soon as the sign is certain; the
+ * decision value is still exact.
+ *
+ * A model with many support vectors can be split into contiguous shards,
+ * one for each thread of a team; each shard is a predictor of its own and
+ * the partial sums are added before rho is subtracted.
+ *
+ * With the LINEAR kernel the decision function is w.x - rho; the support
+ * vectors are folded into one dense weight array indexed by term id, so
+ * the prediction is one sparse-dense dot product. The models with the
+ * other kernels are predicted by libsvm with the buffers of the predictor,
+ * so the prediction never allocates.
+ *
+ * The RBF model can also be served approximately with D random Fourier
+ * frequencies: each column of W is drawn from N(0, 2*gamma) and
+ * z(x) = sqrt(1/D)*[cos(W.x), sin(W.x)], so K(x, sv) ~ z(x).z(sv). The
+ * paired cosine and sine have less variance than one cosine with a random
+ * phase. The support vectors are folded into one weight per feature and
+ * the prediction costs O(nnz*D) whatever the number of support vectors. W
+ * is drawn from a fixed seed by term id, so the columns of the terms that
+ * are in no support vector are drawn again when they are needed.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PREDICT_H
+#define PREDICT_H
+#include "../deps/libsvm/svm.h"
+#include "team.h"
+
+/* Macros */
+/* Seed of the random Fourier features */
+#define PREDICT_RFF_SEED 0x5a70e71ULL
+/* Exponent below which the exponential is 0; exp(x) is subnormal */
+#define PREDICT_MIN_EXP -708.0
+/* Number of the support vectors evaluated between two checks of the
+ * bounds of the decision value */
+#define PREDICT_BLOCK 64
+/* Number of the queries that share one pass over the postings and the
+ * number of the support vectors of one tile of the batch; the dot
+ * products of one tile fit in the L1 cache */
+#define PREDICT_BATCH 4
+#define PREDICT_TILE 1024
+/* Maximum number of the random Fourier frequencies and the maximum size
+ * in bytes of their columns; one column of floats is kept for each term id */
+#define PREDICT_MAX_RFF 16384
+#define PREDICT_MAX_RFF_BYTES (256L << 20)
+
+/* predict_posting: one value of a support vector in the posting list of
+ * its term id */
+struct predict_posting {
+    int sv;
+    double value;
+};
+
+/* predict_entry: one value of a query of the batch in the list of its
+ * term id; NEXT is the next entry of the same term id or -1 */
+struct predict_entry {
+    int id;
+    int q;
+    int next;
+    double value;
+};
+
+/* predict_group: the queries of the batch that have one term and their
+ * values; CURSOR is the next posting of the term up to LAST */
+struct predict_group {
+    long cursor;
+    long last;
+    int nqs;
+    int qs[PREDICT_BATCH];
+    double values[PREDICT_BATCH];
+};
+
+/* predictor: represents the prediction engine of one model. It only
+ * reads the model, the model must outlive it */
+struct predictor {
+    const struct svm_model *model;
+
+    /* Number of support vectors, the kernel parameter and the offset of
+     * the decision function */
+    int l;
+    double gamma;
+    double rho;
+
+    /* The kernel is neither RBF nor LINEAR; libsvm predicts with SCRATCH
+     * and none of the arrays below is used */
+    struct svm_scratch *scratch;
+
+    /* The kernel is LINEAR; only WEIGHTS is used */
+    int is_linear;
+    float *weights;
+
+    /* Number of the random Fourier frequencies; 0 if the kernel is exact.
+     * The column of W of term id ID is OMEGA[ID*NDIMS] and the folded
+     * weights of the cosine and the sine features. PROJ and COLUMN are
+     * the scratch of the projection of the query and the column of an
+     * unknown term */
+    int ndims;
+    float *omega;
+    double *coswts;
+    double *sinwts;
+    double *proj;
+    float *column;
+
+    /* Coefficient and squared norm of each support vector by descending
+     * coefficient; ORDER is the index in the model of each of them and
+     * MASSES[I] is the sum of the coefficients from I up to L */
+    double *coefs;
+    double *norms;
+    int *order;
+    double *masses;
+
+    /* The postings of term id ID are POSTINGS[STARTS[ID]] up to
+     * POSTINGS[STARTS[ID+1]]; the ids are below NIDS */
+    int nids;
+    long *starts;
+    struct predict_posting *postings;
+
+    /* Dot product of the query with each support vector; reused for the
+     * distances and the kernel values. In a batch it's the dot products of
+     * one tile by support vector and ROWS has one block of them for each
+     * query */
+    double *dots;
+    double *rows;
+
+    /* First entry of each term id in the batch or -1, the entries of the
+     * values of the batch and the group of each term; both have room for
+     * MAXENTRIES */
+    int *heads;
+    struct predict_entry *entries;
+    struct predict_group *groups;
+    int maxentries;
+
+    /* Evaluate the kernel with exp(3) one by one; the reference of the
+     * SIMD exponential for validation; set by predictor_scalar_exp */
+    int is_scalar;
+
+    /* Number of the support vectors evaluated by the last prediction or
+     * the last batch */
+    int nevals;
+
+    /* The shards of the support vectors evaluated on the threads of TEAM
+     * and the sum of each of them for the QUERY; 0 shards if the
+     * predictor is not split */
+    int nshards;
+    struct predictor **shards;
+    struct team *team;
+    double *partials;
+    const struct svm_node *query;
+};
+
+/* Prototypes */
+struct predictor *predictor_new(const struct svm_model *model);
+struct predictor *predictor_rff(const struct svm_model *model, int ndims);
+int predictor_rff_limit(long nids);
+struct predictor *predictor_parallel(const struct svm_model *model, struct team *team);
+double predictor_decision(struct predictor *p, const struct svm_node *x);
+double predictor_predict(struct predictor *p, const struct svm_node *x);
+void predictor_predict_batch(struct predictor *p, struct svm_node **xs, int n, double *out);
+void predictor_scalar_exp(struct predictor *p);
+double predictor_agreement(struct predictor *exact, struct predictor *approx, struct svm_node **xs, int n,
+    double *meanerr, double *maxerr);
+void predictor_destroy(struct predictor *p);
+
+#endif
@@ -20,13 +20,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
 #include <libmill.h>
 
 #include "utils.h"
 #include "dict.h"
+#include "vocab.h"
+#include "eytz.h"
 #include "stopwords.h"
+#include "stemmer.h"
+#include "html.h"
 #include "corpus.h"
 #include "train.h"
+#include "predict.h"
 
 #include "../deps/libsvm/svm.h"
 
@@ -38,12 +45,48 @@ const char *argp_program_version = "0.0.1";
 const char *argp_program_bug_address = "bayualdiyansyah@gmail.com";
 const char *short_desc = "Sayoeti -- An AI that can understand which document is about Indonesian corruption news";
 
+/* Keys of the options without short name */
+enum {
+    OPT_MIN_DF = 256,
+    OPT_MAX_DF_RATIO,
+    OPT_MAX_FEATURES,
+    OPT_STEM,
+    OPT_HASH_FEATURES,
+    OPT_NGRAMS,
+    OPT_NGRAM_BITS,
+    OPT_NGRAM_MIN_DF,
+    OPT_HTML,
+    OPT_MAIN_CONTENT,
+    OPT_LINEAR,
+    OPT_RFF,
+    OPT_SCALAR_EXP,
+    OPT_THREADS,
+    OPT_TERMS
+};
+
 /* Available options for the program; used by argp_parser */
 static struct argp_option available_options[] = {
     {"corpus", 'c', "DIR", 0, "Path to corpus directory (required)" },
     {"stopwords", 's', "FILE", 0, "File containing new line separated stop words (optional)" },
     {"listen", 'l', "PORT", 0, "Port to listen too (default: 9090)" },
     {"debug", 'd', 0, 0, "Print all debug information to STDOUT" },
+    {"save", 'o', "PREFIX", 0, "Save the trained snapshot to PREFIX.vocab and PREFIX.model (optional)" },
+    {"load", 'i', "PREFIX", 0, "Serve the snapshot PREFIX.vocab and PREFIX.model instead of training (optional)" },
+    {"min-df", OPT_MIN_DF, "N", 0, "Drop the terms that appear in less than N documents (default: 1)" },
+    {"max-df-ratio", OPT_MAX_DF_RATIO, "RATIO", 0, "Drop the terms that appear in more than RATIO of all documents (default: 1.0)" },
+    {"max-features", OPT_MAX_FEATURES, "N", 0, "Keep at most N most common terms (default: 0, no limit)" },
+    {"hash-features", OPT_HASH_FEATURES, "BITS", 0, "Hash each term to one of 2^BITS ids instead of building the index vocabulary (optional)" },
+    {"ngrams", OPT_NGRAMS, "N", 0, "Add the word n-grams up to N words as hashed features (default: 1, terms only)" },
+    {"ngram-bits", OPT_NGRAM_BITS, "BITS", 0, "Hash each word n-gram to one of 2^BITS ids (default: 18)" },
+    {"ngram-min-df", OPT_NGRAM_MIN_DF, "N", 0, "Drop the n-gram ids that appear in less than N documents (default: 2)" },
+    {"html", OPT_HTML, 0, 0, "The requests are raw HTML; strip the tags, scripts and styles before tokenization" },
+    {"main-content", OPT_MAIN_CONTENT, 0, 0, "Same as --html but keep only the main content of the page" },
+    {"linear", OPT_LINEAR, 0, 0, "Train with the linear kernel; the prediction cost doesn't depend on the number of support vectors" },
+    {"rff", OPT_RFF, "D", 0, "Serve the RBF model approximately with D random Fourier frequencies (optional)" },
+    {"scalar-exp", OPT_SCALAR_EXP, 0, 0, "Evaluate the RBF kernel with exp(3) one by one; report the error of the SIMD exponential after training" },
+    {"threads", OPT_THREADS, "K", 0, "Split the support vectors of the RBF model into K shards predicted in parallel (default: 1)" },
+    {"stem", OPT_STEM, "FILE", 0, "File containing new line separated root words; index the stem of each word (optional)" },
+    {"terms", OPT_TERMS, "PREFIX", 0, "Print the terms of the index vocabulary that start with PREFIX after the training (optional)" },
     { 0 } // entry for termination
 };
 
@@ -54,13 +97,50 @@ struct options {
     char *corpus_dir;
     char *stopwords_file;
     char *port;
+    char *save_prefix;
+    char *load_prefix;
+    long min_df;
+    double max_df_ratio;
+    long max_features;
+    char *roots_file;
+    int hash_bits;
+    int ngrams;
+    int ngram_bits;
+    long ngram_min_df;
+    int html;
+    int html_flags;
+    int linear;
+    int rff;
+    int scalar_exp;
+    int threads;
+    char *terms_prefix;
 };
 
+/* parse_number: get the whole argument ARG of the option NAME as a number
+ * between MIN and MAX; the garbage and the out of range values are
+ * rejected by argp_error, which exits */
+long parse_number(struct argp_state *state, char *name, char *arg, long min, long max)
+{
+    char *endp;
+    errno = 0;
+    long value = strtol(arg, &endp, 10);
+    if(*arg != '\0' && *endp == '\0' && errno == 0 && value >= min && value <= max) {
+        return value;
+    }
+    if(max == LONG_MAX) {
+        argp_error(state, "--%s must be a whole number of at least %ld", name, min);
+    } else {
+        argp_error(state, "--%s must be a whole number between %ld and %ld", name, min, max);
+    }
+    return min;
+}
+
 /* parse_opt get called for each option parsed; used by arg_parser */
 error_t parse_opt(int key, char *arg, struct argp_state *state)
 {
     /* get the input */
     struct options *opts = state->input;
+    char *endp;
     switch (key) {
     case 'd':
         opts->debug = 1;
@@ -74,6 +154,71 @@ error_t parse_opt(int key, char *arg, struct argp_state *state)
     case 'l':
         opts->port = arg;
         break;
+    case 'o':
+        opts->save_prefix = arg;
+        break;
+    case 'i':
+        opts->load_prefix = arg;
+        break;
+    case OPT_MIN_DF:
+        opts->min_df = parse_number(state, "min-df", arg, 1, LONG_MAX);
+        break;
+    case OPT_MAX_DF_RATIO:
+        opts->max_df_ratio = strtod(arg, &endp);
+        if(*arg == '\0' || *endp != '\0' || !(opts->max_df_ratio > 0 && opts->max_df_ratio <= 1)) {
+            argp_error(state, "--max-df-ratio must be greater than 0 and at most 1");
+        }
+        break;
+    case OPT_MAX_FEATURES:
+        opts->max_features = parse_number(state, "max-features", arg, 0, LONG_MAX);
+        break;
+    case OPT_STEM:
+        opts->roots_file = arg;
+        break;
+    case OPT_HASH_FEATURES:
+        opts->hash_bits = (int)parse_number(state, "hash-features", arg, 1, VOCAB_MAX_HASHBITS);
+        break;
+    case OPT_NGRAMS:
+        opts->ngrams = (int)parse_number(state, "ngrams", arg, 1, VOCAB_MAX_NGRAMS);
+        break;
+    case OPT_NGRAM_BITS:
+        opts->ngram_bits = (int)parse_number(state, "ngram-bits", arg, 1, VOCAB_MAX_HASHBITS);
+        break;
+    case OPT_NGRAM_MIN_DF:
+        opts->ngram_min_df = parse_number(state, "ngram-min-df", arg, 1, LONG_MAX);
+        break;
+    case OPT_HTML:
+        opts->html = 1;
+        break;
+    case OPT_MAIN_CONTENT:
+        opts->html = 1;
+        opts->html_flags |= HTML_MAIN_CONTENT;
+        break;
+    case OPT_LINEAR:
+        opts->linear = 1;
+        break;
+    case OPT_RFF:
+        opts->rff = (int)parse_number(state, "rff", arg, 1, PREDICT_MAX_RFF);
+        break;
+    case OPT_SCALAR_EXP:
+        opts->scalar_exp = 1;
+        break;
+    case OPT_THREADS:
+        opts->threads = (int)parse_number(state, "threads", arg, 1, TEAM_MAX_THREADS);
+        break;
+    case OPT_TERMS:
+        opts->terms_prefix = arg;
+        break;
+    case ARGP_KEY_END:
+        /* The hashed ids have no terms to prune */
+        if(opts->hash_bits && (opts->min_df != 1 || opts->max_df_ratio != 1.0 || opts->max_features != 0)) {
+            argp_error(state, "--min-df, --max-df-ratio and --max-features can't be used with --hash-features");
+        }
+        /* Only the training has the index vocabulary in order */
+        if(opts->terms_prefix && (opts->hash_bits || opts->load_prefix)) {
+            argp_error(state, "--terms can't be used with --hash-features or -i");
+        }
+        break;
     default:
         return ARGP_ERR_UNKNOWN;
     }
@@ -81,77 +226,295 @@ error_t parse_opt(int key, char *arg, struct argp_state *state)
 }
 
 /****************************
- * Main program
+ * Training & snapshot
  ****************************/
-int main(int argc, char** argv) {
 
-    /* Set default value for each available option */
-    struct options opts;
-    opts.debug = 0;
-    opts.corpus_dir = NULL;
-    opts.stopwords_file = NULL;
-    opts.port = NULL;
+/* snapshot_path: get the path of snapshot file PREFIX.EXT; the returned
+ * string should be freed by the caller */
+char *snapshot_path(char *prefix, char *ext)
+{
+    char *path = (char *)malloc(sizeof(char) * (strlen(prefix) + strlen(ext) + 2));
+    if(path == NULL) {
+        perror("sayoeti: couldn't create snapshot path");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(path, "%s.%s", prefix, ext);
+    return path;
+}
 
-    /* Parse the arguments; every option seen by parse_opt 
-     * will be reflected in opts. */
-    struct argp argp_parser = {available_options, parse_opt, 0, short_desc};
-    argp_parse(&argp_parser, argc, argv, 0, 0, &opts);
+/* sayoeti_ngram_df: count the number of documents of each id of CDOCS up
+ * to NIDS and drop the n-gram ids after NUNIGRAMS that are too rare. It
+ * returns the number of documents of each id; the number of kept n-gram
+ * ids is saved to NNGRAMSP */
+int *sayoeti_ngram_df(struct options *opts, int ndocs, struct corpus_doc **cdocs, long nunigrams,
+    long nids, long *nngramsp)
+{
+    int *dfs = corpus_df(ndocs, cdocs, nids);
+    if(dfs == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't compute IDF: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
 
-    /* Exit if corpus_dir is not specified */
-    if(!opts.corpus_dir) {
-        fprintf(stderr, "-c options is required. Please see %s --help\n", argv[0]);
+    *nngramsp = 0;
+    if(opts->ngrams > 1) {
+        *nngramsp = corpus_prune_df(ndocs, cdocs, dfs, nunigrams + 1, nids, opts->ngram_min_df);
+        printf("sayoeti: keep %li n-gram ids of 2^%d\n", *nngramsp, opts->ngram_bits);
+    }
+    return dfs;
+}
+
+/* sayoeti_index: create the index vocabulary of the corpus specified in
+ * OPTS excluding the words in STOPW_DICT; the words are stemmed by STEM if
+ * it's not NULL. The sparse representation of each document is saved to
+ * CDOCSP, the number of documents to NDOCSP and the number of terms and
+ * n-grams to NFEATURESP. It returns the frozen index vocabulary */
+struct vocab *sayoeti_index(struct options *opts, struct dict *stopw_dict, struct stemmer *stem,
+    int *ndocsp, struct corpus_doc ***cdocsp, long *nfeaturesp)
+{
+    /* Create index vocabulary from corpus; the number of documents of
+     * each term is counted while we read it */
+    printf("sayoeti: Create index vocabulary from corpus %s\n", opts->corpus_dir);
+    struct dict *index = corpus_index(opts->corpus_dir, stopw_dict, stem);
+    if(index == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't create index vocabulary from corpus: %s; %s\n", 
+            opts->corpus_dir, strerror(errno));
         exit(EXIT_FAILURE);
     }
-    
+    printf("sayoeti: Index vocabulary from corpus %s created.\n", opts->corpus_dir);
+
+    /* Uncomment this to print the index vocabulary to STDOUT */
+    // dict_printout(index);
+
+    /* Give the most common terms the smallest ids */
+    printf("sayoeti: renumber terms by document frequency\n");
+    if(corpus_index_renumber(index) != 0) {
+        fprintf(stderr, "sayoeti: Couldn't renumber terms: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* Drop the rare and the too common terms; the ids are compacted */
+    struct dict *pruned = corpus_index_prune(index, opts->min_df, opts->max_df_ratio, opts->max_features);
+    if(pruned == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't prune index vocabulary: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    printf("sayoeti: keep %li of %li terms\n", pruned->nitems, index->nitems);
+    if(pruned->nitems == 0) {
+        fprintf(stderr, "sayoeti: No term is left; loosen --min-df, --max-df-ratio or --max-features\n");
+        exit(EXIT_FAILURE);
+    }
+    dict_destroy(index);
+    index = pruned;
+
+    /* Print the index vocabulary or the terms that start with the prefix
+     * in alphabetical order */
+    if(opts->debug || opts->terms_prefix) {
+        struct eytz *sorted = eytz_build(index);
+        if(sorted == NULL) {
+            fprintf(stderr, "sayoeti: Couldn't sort index vocabulary: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if(opts->debug) {
+            eytz_print(sorted);
+        }
+        if(opts->terms_prefix) {
+            printf("sayoeti: terms that start with %s\n", opts->terms_prefix);
+            long nterms = eytz_print_prefix(sorted, opts->terms_prefix);
+            printf("sayoeti: %li terms start with %s\n", nterms, opts->terms_prefix);
+        }
+        eytz_destroy(sorted);
+    }
+
+    /* Create sparse representation of corpus documents with the final
+     * ids; the n-grams are built from them */
+    struct corpus_doc **cdocs = corpus_doc_sparse(opts->corpus_dir, index, stem, opts->ngrams, opts->ngram_bits);
+    if(cdocs == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't read corpus: %s; %s\n", 
+            opts->corpus_dir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* The IDF of the n-grams comes from the documents */
+    int *dfs = NULL;
+    long nngrams = 0;
+    if(opts->ngrams > 1) {
+        dfs = sayoeti_ngram_df(opts, index->ndocs, cdocs, index->nitems,
+            index->nitems + (1L << opts->ngram_bits), &nngrams);
+    }
+
+    /* The index vocabulary never changes from now on; freeze it */
+    printf("sayoeti: freeze index vocabulary\n");
+    struct vocab *vocab = vocab_freeze(index, stem ? VOCAB_STEMMED : 0, opts->ngrams, opts->ngram_bits, dfs);
+    if(vocab == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't freeze index vocabulary: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    free(dfs);
+
+    /* The server only needs the frozen vocabulary */
+    *ndocsp = index->ndocs;
+    *cdocsp = cdocs;
+    *nfeaturesp = index->nitems + nngrams;
+    dict_destroy(index);
+
+    return vocab;
+}
+
+
+/* sayoeti_index_hashed: same as sayoeti_index but each term is hashed to
+ * its id; no index vocabulary is built or searched */
+struct vocab *sayoeti_index_hashed(struct options *opts, struct dict *stopw_dict, struct stemmer *stem,
+    int *ndocsp, struct corpus_doc ***cdocsp, long *nfeaturesp)
+{
+    /* Create sparse representation of corpus documents */
+    printf("sayoeti: hash terms of corpus %s to 2^%d ids\n", opts->corpus_dir, opts->hash_bits);
+    int ndocs = 0;
+    struct corpus_doc **cdocs = corpus_doc_hashed(opts->corpus_dir, stopw_dict, stem, opts->hash_bits,
+        opts->ngrams, opts->ngram_bits, &ndocs);
+    if(cdocs == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't read corpus: %s; %s\n", 
+            opts->corpus_dir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* Compute global IDF for each hashed id */
+    printf("sayoeti: compute global IDF for each hashed id\n");
+    long nunigrams = 1L << opts->hash_bits;
+    long nids = nunigrams + (opts->ngrams > 1 ? (1L << opts->ngram_bits) : 0);
+    long nngrams = 0;
+    int *dfs = sayoeti_ngram_df(opts, ndocs, cdocs, nunigrams, nids, &nngrams);
+
+    /* No term id is dropped; only count the used ones */
+    long nfeatures = corpus_prune_df(ndocs, cdocs, dfs, 1, nunigrams, 1);
+    printf("sayoeti: %li of %li ids are used\n", nfeatures, nunigrams);
+
+    long flags = stem ? VOCAB_STEMMED : 0;
+    struct vocab *vocab = vocab_hashed(opts->hash_bits, ndocs, dfs, flags, opts->ngrams, opts->ngram_bits,
+        stopw_dict);
+    if(vocab == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't create hashed vocabulary: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    free(dfs);
+
+    *ndocsp = ndocs;
+    *cdocsp = cdocs;
+    *nfeaturesp = nfeatures + nngrams;
+    return vocab;
+}
+
+/* sayoeti_rff_check: exit if the columns of NDIMS random Fourier
+ * frequencies of all term ids of VOCAB don't fit in the memory budget */
+void sayoeti_rff_check(int ndims, struct vocab *vocab)
+{
+    int limit = predictor_rff_limit(vocab->nids);
+    if(ndims > limit) {
+        fprintf(stderr, "sayoeti: --rff %d is too large for %ld term ids; use at most %d\n",
+            ndims, vocab->nids, limit);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* sayoeti_rff_report: print the agreement of the model MODEL served with
+ * the random Fourier features and the exact model on the documents of the
+ * problem SVMP; the number of features is doubled from 64 up to NDIMS */
+void sayoeti_rff_report(struct svm_model *model, struct svm_problem *svmp, int ndims)
+{
+    struct predictor *exact = predictor_new(model);
+    if(exact == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't create predictor: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    int d = 64;
+    while(1) {
+        if(d > ndims) d = ndims;
+        struct predictor *approx = predictor_rff(model, d);
+        if(approx == NULL) {
+            fprintf(stderr, "sayoeti: Couldn't create RFF predictor: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        double meanerr, maxerr;
+        double agree = predictor_agreement(exact, approx, svmp->x, svmp->l, &meanerr, &maxerr);
+        printf("sayoeti: rff %d frequencies: %.2f%% same label; decision error mean %g max %g\n",
+            d, agree * 100, meanerr, maxerr);
+        predictor_destroy(approx);
+        if(d == ndims) break;
+        d *= 2;
+    }
+
+    predictor_destroy(exact);
+}
+
+/* sayoeti_exp_report: print the agreement of the model MODEL served with
+ * the SIMD exponential and with exp(3) on the documents of the problem
+ * SVMP */
+void sayoeti_exp_report(struct svm_model *model, struct svm_problem *svmp)
+{
+    struct predictor *scalar = predictor_new(model);
+    struct predictor *simd = predictor_new(model);
+    if(scalar == NULL || simd == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't create predictor: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    predictor_scalar_exp(scalar);
+
+    double meanerr, maxerr;
+    double agree = predictor_agreement(scalar, simd, svmp->x, svmp->l, &meanerr, &maxerr);
+    printf("sayoeti: simd exp: %.2f%% same label; decision error mean %g max %g\n",
+        agree * 100, meanerr, maxerr);
+
+    predictor_destroy(simd);
+    predictor_destroy(scalar);
+}
+
+/* sayoeti_train: train the model from corpus specified in OPTS; the words
+ * are stemmed by STEM if it's not NULL. The frozen index vocabulary is saved
+ * to VOCABP */
+struct svm_model *sayoeti_train(struct options *opts, struct stemmer *stem, struct vocab **vocabp)
+{
     /* Skip building stop words dictionary if the FILE is not provided */
-    if(!opts.stopwords_file) {
+    if(!opts->stopwords_file) {
         printf("sayoeti: Stop words file is not specified.\n");
         printf("sayoeti: Skipping process building stop words dictionary.\n");
     }
 
     /* Create stop words dictionary if the FILE is specified */
     struct dict *stopw_dict = NULL;
-    if(opts.stopwords_file) {
-        printf("sayoeti: Create stop words dictionary from %s\n", opts.stopwords_file);
-        stopw_dict = stopw_dict_create(opts.stopwords_file);
+    if(opts->stopwords_file) {
+        printf("sayoeti: Create stop words dictionary from %s\n", opts->stopwords_file);
+        stopw_dict = stopw_dict_create(opts->stopwords_file);
         if(stopw_dict == NULL) {
             fprintf(stderr, "sayoeti: Couldn't create dicitonary from file: %s; %s\n", 
-                opts.stopwords_file, strerror(errno));
+                opts->stopwords_file, strerror(errno));
             exit(EXIT_FAILURE);
         }
 
         /* Uncoment to see the stopwords dictionary */
         // dict_printout(stopw_dict);
-        printf("sayoeti: stop words dictionary from %s is created.\n", opts.stopwords_file);
+        printf("sayoeti: stop words dictionary from %s is created.\n", opts->stopwords_file);
     }
 
-    /* Create index vocabulary from corpus */
-    printf("sayoeti: Create index vocabulary from corpus %s\n", opts.corpus_dir);
-    struct dict *index = corpus_index(opts.corpus_dir, stopw_dict);
-    if(index == NULL) {
-        fprintf(stderr, "sayoeti: Couldn't create index vocabulary from corpus: %s; %s\n", 
-            opts.corpus_dir, strerror(errno));
-        exit(EXIT_FAILURE);
+    /* Create the sparse representation of the corpus documents */
+    int ndocs = 0;
+    long nfeatures = 0;
+    struct corpus_doc **cdocs = NULL;
+    struct vocab *vocab = NULL;
+    if(opts->hash_bits) {
+        vocab = sayoeti_index_hashed(opts, stopw_dict, stem, &ndocs, &cdocs, &nfeatures);
+    } else {
+        vocab = sayoeti_index(opts, stopw_dict, stem, &ndocs, &cdocs, &nfeatures);
+    }
+    if(opts->rff && !opts->linear) {
+        sayoeti_rff_check(opts->rff, vocab);
     }
-    printf("sayoeti: Index vocabulary from corpus %s created.\n", opts.corpus_dir);
-
-    /* Uncomment this to print the index vocabulary to STDOUT */
-    // dict_printout(index);
-
-    /* Create sparse representation of corpus documents */
-    struct corpus_doc **cdocs = corpus_doc_sparse(opts.corpus_dir, index);
 
-    /* Compute global IDF for each term in index vocabulary */
-    printf("sayoeti: compute global IDF for each term in index vocabulary\n");
-    corpus_index_idf(index->ndocs, cdocs, index->root);
-    // dict_printout(index);
-    
     /* Create a SVM parameter */
     struct svm_parameter param;
     param.svm_type = ONE_CLASS;
-    param.kernel_type = RBF;
+    param.kernel_type = opts->linear ? LINEAR : RBF;
     param.degree = 3;
-    param.gamma = (double)1/index->nitems;
+    param.gamma = (double)1/nfeatures;
     param.coef0 = 0;
     param.nu = 0.387;
     param.cache_size = 100;
@@ -166,7 +529,7 @@ int main(int argc, char** argv) {
 
     /* Create SVM problem based on CDOCS and index */
     printf("sayoeti: create a problem\n");
-    struct svm_problem *svmp = train_problem_create(index->ndocs, cdocs, index);
+    struct svm_problem *svmp = train_problem_create(ndocs, cdocs, vocab);
     if(svmp == NULL) {
         fprintf(stderr, "sayoeti: Couldn't create SVM Problem: %s\n", strerror(errno));
         exit(EXIT_FAILURE);
@@ -183,99 +546,452 @@ int main(int argc, char** argv) {
     /* Create the training model */
     struct svm_model *model = svm_train(svmp, &param);
 
-    /* Listening to port */
-    int port = 9090;
-    if(opts.port != NULL) port = atoi(opts.port);
-    
-    /* Set the address to bind to */
-    ipaddr addr = iplocal("127.0.0.1", port, IPADDR_IPV4);
-    
-    /* Start listening for TCP connection */
-    tcpsock listener = tcplisten(addr, 10);
-    if(listener == NULL) {
-        perror("sayoeti: couldn't listeing to socket");
+    /* Report how well the random Fourier features agree with the exact
+     * kernel on the training documents */
+    if(opts->rff && !opts->linear) {
+        sayoeti_rff_report(model, svmp, opts->rff);
+    }
+
+    /* Report how far the SIMD exponential is from exp(3) on the training
+     * documents */
+    if(opts->scalar_exp && !opts->linear) {
+        sayoeti_exp_report(model, svmp);
+    }
+
+    if(stopw_dict) dict_destroy(stopw_dict);
+
+    *vocabp = vocab;
+    return model;
+}
+
+/* sayoeti_save: save the frozen vocabulary VOCAB and the model MODEL to
+ * snapshot PREFIX */
+void sayoeti_save(char *prefix, struct vocab *vocab, struct svm_model *model)
+{
+    char *vocab_path = snapshot_path(prefix, "vocab");
+    char *model_path = snapshot_path(prefix, "model");
+
+    printf("sayoeti: save snapshot to %s and %s\n", vocab_path, model_path);
+    if(vocab_save(vocab, vocab_path) != 0 || svm_save_model(model_path, model) != 0) {
+        fprintf(stderr, "sayoeti: Couldn't save snapshot: %s; %s\n",
+            prefix, strerror(errno));
         exit(EXIT_FAILURE);
     }
-    printf("sayoeti: listening on port :%d\n", port);
 
+    free(vocab_path);
+    free(model_path);
+}
+
+/* sayoeti_load: load the frozen vocabulary and the model from snapshot
+ * PREFIX. The frozen vocabulary is saved to VOCABP */
+struct svm_model *sayoeti_load(char *prefix, struct vocab **vocabp)
+{
+    char *vocab_path = snapshot_path(prefix, "vocab");
+    char *model_path = snapshot_path(prefix, "model");
+
+    printf("sayoeti: load frozen vocabulary from %s\n", vocab_path);
+    struct vocab *vocab = vocab_load(vocab_path);
+    if(vocab == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't load frozen vocabulary: %s; %s\n",
+            vocab_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    printf("sayoeti: load model from %s\n", model_path);
+    struct svm_model *model = svm_load_model(model_path);
+    if(model == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't load model: %s\n", model_path);
+        exit(EXIT_FAILURE);
+    }
+
+    free(vocab_path);
+    free(model_path);
+
+    *vocabp = vocab;
+    return model;
+}
+
+/****************************
+ * Server
+ ****************************/
+
+/* Maximum number of the requests predicted in one batch */
+#define SAYOETI_BATCH_MAX 32
+/* Maximum time in milliseconds the first request of a batch waits for the
+ * others; the clock of libmill has millisecond resolution */
+#define SAYOETI_BATCH_MAX_WAIT 1
+/* Weight of the last sample of the moving averages of the load */
+#define SAYOETI_LOAD_WEIGHT 0.125
+/* Time in microseconds between two requests above which the server is
+ * idle; the longer gaps count as this one */
+#define SAYOETI_IDLE_GAP 10000.0
+
+/* sayoeti_job: one vectorized request waiting for its prediction; the
+ * label is sent to DONE */
+struct sayoeti_job {
+    struct svm_node *x;
+    chan done;
+};
+
+/* sayoeti_server: the state shared by all connections */
+struct sayoeti_server {
+    struct options *opts;
+    struct vocab *vocab;
+    struct stemmer *stem;
+    struct corpus_tf *tf;
+    struct predictor *pred;
+
+    /* The requests waiting for the batcher */
+    chan jobs;
+
+    /* Moving averages in microseconds of the time between two requests
+     * and of the time to predict one batch, and the arrival time of the
+     * last request */
+    double gap;
+    double latency;
+    int64_t last;
+};
+
+/* sayoeti_usec: get the monotonic time in microseconds */
+int64_t sayoeti_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* sayoeti_tick: send to TICK at DEADLINE in milliseconds; libmill 1.2 has
+ * no deadline clause in choose. TICK is buffered, so it never blocks */
+coroutine void sayoeti_tick(chan tick, int64_t deadline)
+{
+    msleep(deadline);
+    chs(tick, int, 1);
+    chclose(tick);
+}
+
+/* sayoeti_batcher: predict the requests of SRV in batches. The batch is
+ * the requests that are already waiting when the first one arrives, plus
+ * the ones that arrive before the limit or the wait. Both come from the
+ * load: the limit is the number of requests that arrive while one batch
+ * is predicted, and the wait is the time they take to arrive, at most one
+ * batch and SAYOETI_BATCH_MAX_WAIT. So an idle server predicts each
+ * request right away */
+coroutine void sayoeti_batcher(struct sayoeti_server *srv)
+{
+    struct sayoeti_job *batch[SAYOETI_BATCH_MAX];
+    struct svm_node *xs[SAYOETI_BATCH_MAX];
+    double labels[SAYOETI_BATCH_MAX];
+
+    while(1) {
+        batch[0] = chr(srv->jobs, struct sayoeti_job *);
+        int n = 1;
+
+        /* Let the connections that are ready submit their requests */
+        yield();
+        while(n < SAYOETI_BATCH_MAX) {
+            struct sayoeti_job *job = NULL;
+            choose {
+            in(srv->jobs, struct sayoeti_job *, next):
+                job = next;
+            otherwise:
+                job = NULL;
+            end
+            }
+            if(job == NULL) break;
+            batch[n++] = job;
+        }
+
+        /* Wait for the requests that are due before this batch would be
+         * done anyway */
+        double expected = srv->latency / srv->gap;
+        int limit = (expected < SAYOETI_BATCH_MAX - 1) ? (int)expected + 1 : SAYOETI_BATCH_MAX;
+        if(n < limit) {
+            /* The clock of libmill counts whole milliseconds */
+            double wait = (limit - n) * srv->gap;
+            if(wait > srv->latency) wait = srv->latency;
+            int64_t ms = ((int64_t)wait + 999) / 1000;
+            if(ms > SAYOETI_BATCH_MAX_WAIT) ms = SAYOETI_BATCH_MAX_WAIT;
+            chan tick = chmake(int, 1);
+            go(sayoeti_tick(chdup(tick), now() + ms));
+            int timeout = 0;
+            while(n < limit && !timeout) {
+                choose {
+                in(srv->jobs, struct sayoeti_job *, next):
+                    batch[n++] = next;
+                in(tick, int, fired):
+                    timeout = fired;
+                end
+                }
+            }
+            chclose(tick);
+        }
+
+        int i;
+        for(i = 0; i < n; i++) {
+            xs[i] = batch[i]->x;
+        }
+        int64_t start = sayoeti_usec();
+        predictor_predict_batch(srv->pred, xs, n, labels);
+        srv->latency += SAYOETI_LOAD_WEIGHT * ((sayoeti_usec() - start) - srv->latency);
+        if(srv->opts->debug) {
+            printf("sayoeti: predict a batch of %d requests; limit %d\n", n, limit);
+            if(!srv->pred->is_linear && !srv->pred->ndims) {
+                printf("sayoeti: decided after %d of %ld support vectors\n", srv->pred->nevals,
+                    (long)n * srv->pred->l);
+            }
+        }
+        for(i = 0; i < n; i++) {
+            chs(batch[i]->done, double, labels[i]);
+        }
+    }
+}
+
+/* sayoeti_serve: serve one request of the connection CONN */
+coroutine void sayoeti_serve(struct sayoeti_server *srv, tcpsock conn)
+{
     /* List of message; inpired by SMTP */
     char *greet = "202 OK sayoeti ready\r\n";
     char *bufferr = "500 BAD bad buffer; terminating connection.\r\n";
     char *cdocerr = "500 BAD cannot create corpus document; terminating connection.\r\n";
-    char *svmnerr = "500 BAD cannot create svm node; terminating connection.\r\n";
-    
-    /* Forever listening */
-    while(1) {
-        tcpsock conn = tcpaccept(listener, -1);
 
-        /* Send greetings */
-        tcpsend(conn, greet, strlen(greet), -1);
-        tcpflush(conn, -1);
+    /* Send greetings */
+    tcpsend(conn, greet, strlen(greet), -1);
+    tcpflush(conn, -1);
 
-        /* Get the input by client */
-        char inbuf[5000];
-        size_t leninbuf = tcprecvuntil(conn, inbuf, sizeof(inbuf), "\r", 1, -1);
+    /* Get the input by client */
+    char inbuf[5000];
+    size_t leninbuf = tcprecvuntil(conn, inbuf, sizeof(inbuf), "\r", 1, -1);
 
-        /* Make sure that input buffer terminated by \r */
-        if(inbuf[leninbuf-1] != '\r') {
-            /* Send errors & close the connection */
-            tcpsend(conn, bufferr, strlen(bufferr), -1);
-            tcpflush(conn, -1);
-            tcpclose(conn);
-        }
+    /* Make sure that input buffer terminated by \r */
+    if(leninbuf == 0 || inbuf[leninbuf-1] != '\r') {
+        /* Send errors & close the connection */
+        tcpsend(conn, bufferr, strlen(bufferr), -1);
+        tcpflush(conn, -1);
+        tcpclose(conn);
+        return;
+    }
 
-        /* Create new corpus document from buffer */
-        struct corpus_doc *cdoc = corpus_doc_createb(leninbuf, inbuf, index);
-        if(cdoc == NULL) {
-            /* Send errors & close the connection */
-            tcpsend(conn, cdocerr, strlen(cdocerr), -1);
-            tcpflush(conn, -1);
-            tcpclose(conn);
+    /* Strip the HTML in place; the buffer is still terminated by \r */
+    if(srv->opts->html) {
+        size_t lenhtml = leninbuf;
+        leninbuf = html_scrub(inbuf, leninbuf, srv->opts->html_flags);
+        if(srv->opts->debug) {
+            printf("sayoeti: scrub %zu bytes of HTML to %zu bytes of text\n", lenhtml, leninbuf);
         }
+    }
 
-        /* create new SVM node */
-        /* Allocate memory for the svm_node array */
-        struct svm_node *svmns = (struct svm_node *)malloc((cdoc->nitems+1) * sizeof(struct svm_node));
-        if(svmns == NULL) {
-            /* Send errors & close the connection */
-            tcpsend(conn, svmnerr, strlen(svmnerr), -1);
-            tcpflush(conn, -1);
-            tcpclose(conn);
+    /* Create new corpus document from buffer; the term frequency table
+     * is shared, but nothing yields until the document is created */
+    struct corpus_doc *cdoc = corpus_doc_createb(leninbuf, inbuf, srv->vocab, srv->tf, srv->stem);
+    if(cdoc == NULL) {
+        /* Send errors & close the connection */
+        tcpsend(conn, cdocerr, strlen(cdocerr), -1);
+        tcpflush(conn, -1);
+        tcpclose(conn);
+        return;
+    }
+
+    /* Weight the document vector in place; it's the svm node array */
+    struct svm_node *svmns = cdoc->nodes;
+    int svmni = train_node_create(cdoc, srv->vocab, svmns);
+
+    /* Print vector representtion */
+    if(srv->opts->debug) {
+        int svmnpi;
+        for(svmnpi = 0; svmnpi < svmni; svmnpi++) {
+            printf("%d:%f ", svmns[svmnpi].index, svmns[svmnpi].value);
         }
+        printf("\n");
+    }
 
-        /* Create svm node for each term in document */
-        int svmni = 0; /* keep track the index of svm node */
-        train_node_create(&svmni, index->ndocs, cdoc, cdoc->root, index, svmns);
+    /* Predict the node with the other waiting requests; its arrival
+     * updates the load */
+    int64_t arrival = sayoeti_usec();
+    double gap = arrival - srv->last;
+    srv->gap += SAYOETI_LOAD_WEIGHT * ((gap < SAYOETI_IDLE_GAP ? gap : SAYOETI_IDLE_GAP) - srv->gap);
+    srv->last = arrival;
+    struct sayoeti_job job;
+    job.x = svmns;
+    job.done = chmake(double, 1);
+    chs(srv->jobs, struct sayoeti_job *, &job);
+    double prediction = chr(job.done, double);
+    chclose(job.done);
+    char res[20];
+    sprintf(res, "RES %.0f\r", prediction);
+
+    /* Send the result */
+    tcpsend(conn, res, strlen(res), -1);
+    tcpflush(conn, -1);
+
+    /* Free the document and its svm nodes */
+    corpus_doc_destroy(cdoc);
+
+    /* Terminate the connection */
+    tcpclose(conn);
+}
 
-        /* Terminate the SVM node */
-        struct svm_node svmn = {-1, 0};
-        svmns[svmni] = svmn;
+/****************************
+ * Main program
+ ****************************/
+int main(int argc, char** argv) {
 
-        /* Print vector representtion */
-        if(opts.debug) {
-            int svmnpi;
-            for(svmnpi = 0; svmnpi < svmni; svmnpi++) {
-                printf("%d:%f ", svmns[svmnpi].index, svmns[svmnpi].value);
-            }
-            printf("\n");
+    /* Set default value for each available option */
+    struct options opts;
+    opts.debug = 0;
+    opts.corpus_dir = NULL;
+    opts.stopwords_file = NULL;
+    opts.port = NULL;
+    opts.save_prefix = NULL;
+    opts.load_prefix = NULL;
+    opts.min_df = 1;
+    opts.max_df_ratio = 1.0;
+    opts.max_features = 0;
+    opts.roots_file = NULL;
+    opts.hash_bits = 0;
+    opts.ngrams = 1;
+    opts.ngram_bits = 18;
+    opts.ngram_min_df = 2;
+    opts.html = 0;
+    opts.html_flags = 0;
+    opts.linear = 0;
+    opts.rff = 0;
+    opts.scalar_exp = 0;
+    opts.threads = 1;
+    opts.terms_prefix = NULL;
+
+    /* Parse the arguments; every option seen by parse_opt 
+     * will be reflected in opts. */
+    struct argp argp_parser = {available_options, parse_opt, 0, short_desc};
+    argp_parse(&argp_parser, argc, argv, 0, 0, &opts);
+
+    /* Exit if corpus_dir is not specified */
+    if(!opts.corpus_dir && !opts.load_prefix) {
+        fprintf(stderr, "-c options is required. Please see %s --help\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    
+    /* Create the stemmer if the root words FILE is specified */
+    struct stemmer *stem = NULL;
+    if(opts.roots_file) {
+        printf("sayoeti: Create stemmer from %s\n", opts.roots_file);
+        stem = stemmer_new(opts.roots_file);
+        if(stem == NULL) {
+            fprintf(stderr, "sayoeti: Couldn't create stemmer from file: %s; %s\n",
+                opts.roots_file, strerror(errno));
+            exit(EXIT_FAILURE);
         }
+    }
+    
+    /* Train the model from corpus or serve the snapshot directly */
+    struct vocab *vocab = NULL;
+    struct svm_model *model = NULL;
+    if(opts.load_prefix) {
+        model = sayoeti_load(opts.load_prefix, &vocab);
+    } else {
+        model = sayoeti_train(&opts, stem, &vocab);
+    }
 
-        /* Predict the node */
-        double prediction = svm_predict(model, svmns);
-        char res[20];
-        sprintf(res, "RES %.0f\r", prediction);
+    /* The requests must be stemmed the same way as the corpus */
+    if((vocab->flags & VOCAB_STEMMED) && stem == NULL) {
+        fprintf(stderr, "sayoeti: The vocabulary is stemmed; --stem is required\n");
+        exit(EXIT_FAILURE);
+    }
+    if(!(vocab->flags & VOCAB_STEMMED) && stem != NULL) {
+        printf("sayoeti: The vocabulary is not stemmed; ignore --stem\n");
+        stemmer_destroy(stem);
+        stem = NULL;
+    }
 
-        /* Send the result */
-        tcpsend(conn, res, strlen(res), -1);
-        tcpflush(conn, -1);
+    /* Save the snapshot, so the next time we can serve it directly */
+    if(opts.save_prefix) {
+        sayoeti_save(opts.save_prefix, vocab, model);
+    }
 
-        /* TODO(pyk): free all allocated memory in this while loop here */
-        /* Terminate the connection */
-        tcpclose(conn);
+    /* The model never changes from now on; invert its support vectors or
+     * fold them into the random Fourier features */
+    if(opts.rff && model->param.kernel_type != RBF) {
+        fprintf(stderr, "sayoeti: --rff requires the RBF kernel\n");
+        exit(EXIT_FAILURE);
+    }
+    if(opts.rff) {
+        sayoeti_rff_check(opts.rff, vocab);
+    }
+    if(opts.threads > 1 && (opts.rff || model->param.kernel_type != RBF)) {
+        printf("sayoeti: --threads requires the exact RBF kernel; predict on one thread\n");
+        opts.threads = 1;
+    }
+    struct team *team = NULL;
+    if(opts.threads > 1) {
+        team = team_new(opts.threads);
+        if(team == NULL) {
+            fprintf(stderr, "sayoeti: Couldn't create thread pool: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    struct predictor *pred = NULL;
+    if(opts.rff) {
+        printf("sayoeti: approximate the kernel with %d random Fourier frequencies\n", opts.rff);
+        pred = predictor_rff(model, opts.rff);
+    } else if(team) {
+        printf("sayoeti: predict %d shards of the support vectors in parallel\n", opts.threads);
+        pred = predictor_parallel(model, team);
+    } else {
+        pred = predictor_new(model);
+    }
+    if(pred == NULL) {
+        fprintf(stderr, "sayoeti: Couldn't create predictor: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if(opts.scalar_exp) {
+        predictor_scalar_exp(pred);
+    }
+
+    /* Listening to port */
+    int port = 9090;
+    if(opts.port != NULL) port = atoi(opts.port);
+    
+    /* Set the address to bind to */
+    ipaddr addr = iplocal("127.0.0.1", port, IPADDR_IPV4);
+    
+    /* Start listening for TCP connection */
+    tcpsock listener = tcplisten(addr, 10);
+    if(listener == NULL) {
+        perror("sayoeti: couldn't listeing to socket");
+        exit(EXIT_FAILURE);
+    }
+    printf("sayoeti: listening on port :%d\n", port);
+
+    /* One term frequency table is reused for all requests */
+    struct corpus_tf *tf = corpus_tf_new(CORPUS_TF_BITS);
+    if(tf == NULL) {
+        perror("sayoeti: couldn't create term frequency table");
+        exit(EXIT_FAILURE);
+    }
+    corpus_tf_ngrams(tf, vocab->ngrams, vocab->ngrambits, vocab->nunigrams);
+
+    /* The requests are predicted in batches by one coroutine */
+    struct sayoeti_server srv;
+    srv.opts = &opts;
+    srv.vocab = vocab;
+    srv.stem = stem;
+    srv.tf = tf;
+    srv.pred = pred;
+    srv.jobs = chmake(struct sayoeti_job *, SAYOETI_BATCH_MAX);
+    srv.gap = SAYOETI_IDLE_GAP;
+    srv.latency = 0;
+    srv.last = sayoeti_usec();
+    go(sayoeti_batcher(&srv));
+
+    /* Forever listening; each connection is served by its own coroutine */
+    while(1) {
+        tcpsock conn = tcpaccept(listener, -1);
+        if(conn == NULL) continue;
+        go(sayoeti_serve(&srv, conn));
     }
 
     /* TODO(pyk) destroy the corpus doc */
-    dict_destroy(stopw_dict);
-    dict_destroy(index);
+    predictor_destroy(pred);
+    team_destroy(team);
+    vocab_destroy(vocab);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,281 @@
+/* Sayoeti Stemmer
+ * Indonesian affix stripper in the style of Nazief-Adriani. The particles
+ * (-lah, -kah, -tah, -pun), the possessive pronouns (-ku, -mu, -nya), the
+ * derivation suffixes (-i, -kan, -an) and up to three derivation prefixes
+ * are removed; every candidate is checked in the root words dictionary, so
+ * "dikorupsi", "mengorupsi" and "korupsinya" are all indexed as "korupsi".
+ * The token is kept as is if no root word is found.
+ *
+ * Stemming is expensive compared to the dictionary lookup and the same
+ * surface forms occur again and again, so the stems are memoized in a
+ * bounded direct-mapped cache.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dict.h"
+#include "bloom.h"
+#include "stemmer.h"
+#include "vocab.h"
+
+/* stemmer_new: creates new stemmer with the root words from file FNAME.
+ * Returns NULL if only if error happen and ERRNO will be set to last
+ * error. */
+struct stemmer *stemmer_new(char *fname)
+{
+    struct stemmer *s = (struct stemmer *)malloc(sizeof(struct stemmer));
+    if(s == NULL) {
+        return NULL;
+    }
+
+    /* The cache starts empty */
+    s->cache = (struct stemmer_entry *)calloc(STEMMER_CACHE_SIZE, sizeof(struct stemmer_entry));
+    if(s->cache == NULL) {
+        free(s);
+        return NULL;
+    }
+
+    /* Read the root words */
+    s->roots = dict_new(fname);
+    if(s->roots == NULL) {
+        return NULL;
+    }
+    FILE *fp = fopen(fname, "r");
+    if(fp == NULL) {
+        return NULL;
+    }
+    if(dict_populatef(fp, NULL, s->roots, NULL) == NULL) {
+        return NULL;
+    }
+    if(fclose(fp) != 0) {
+        return NULL;
+    }
+
+    /* Root words never change; use the trie backend */
+    if(dict_compile(s->roots) != 0) {
+        return NULL;
+    }
+
+    return s;
+}
+
+/* stemmer_is_vowel: check wether the character C is a vowel */
+static int stemmer_is_vowel(char c)
+{
+    return c == 'a' || c == 'i' || c == 'u' || c == 'e' || c == 'o';
+}
+
+/* stemmer_starts: check wether the word WORD starts with PREFIX */
+static int stemmer_starts(char *word, char *prefix)
+{
+    return strncmp(word, prefix, strlen(prefix)) == 0;
+}
+
+/* stemmer_strip_suffix: remove the suffix SUFFIX from the word WORD in
+ * place. At least two characters are left. It returns TRUE if the suffix
+ * is removed */
+static int stemmer_strip_suffix(char *word, char *suffix)
+{
+    size_t len = strlen(word);
+    size_t lensuffix = strlen(suffix);
+    if(len < lensuffix + 2 || strcmp(word + len - lensuffix, suffix) != 0) {
+        return FALSE;
+    }
+    word[len - lensuffix] = '\0';
+    return TRUE;
+}
+
+/* stemmer_prefixes: get the candidates of word WORD without its first
+ * derivation prefix. The nasal of me- and pe- replaces the first letter of
+ * the root word, so it's restored: "mengorupsi" gives "orupsi" and
+ * "korupsi". The candidates are saved to CANDS; it returns the number of
+ * candidates */
+static int stemmer_prefixes(char *word, char cands[STEMMER_MAX_CANDS][STEMMER_KEY_SIZE])
+{
+    /* Keep at least two characters of the root word */
+    size_t len = strlen(word);
+    int n = 0;
+
+#define STEMMER_CAND(restore, skip) \
+    if(len >= (skip) + 2) snprintf(cands[n++], STEMMER_KEY_SIZE, "%s%s", (restore), word + (skip))
+
+    if(stemmer_starts(word, "di") || stemmer_starts(word, "ke") || stemmer_starts(word, "se")) {
+        STEMMER_CAND("", 2);
+    } else if(stemmer_starts(word, "ber") || stemmer_starts(word, "ter") || stemmer_starts(word, "per")) {
+        /* ber-lari; be-rumah if the root starts with r */
+        STEMMER_CAND("", 3);
+        if(stemmer_is_vowel(word[3])) STEMMER_CAND("", 2);
+    }
+
+    /* be-kerja, pe-kerja; "pemeriksa" is pem-periksa, so the nasal rules
+     * below are tried too */
+    if((stemmer_starts(word, "be") || stemmer_starts(word, "pe")) && !stemmer_is_vowel(word[2]) &&
+       word[2] != 'r' && strncmp(word + 3, "er", 2) == 0) {
+        STEMMER_CAND("", 2);
+    }
+
+    if(stemmer_starts(word, "meng") || stemmer_starts(word, "peng")) {
+        STEMMER_CAND("", 4);
+        if(stemmer_is_vowel(word[4])) STEMMER_CAND("k", 4);
+    } else if(stemmer_starts(word, "meny") || stemmer_starts(word, "peny")) {
+        if(stemmer_is_vowel(word[4])) STEMMER_CAND("s", 4);
+    } else if(stemmer_starts(word, "mem") || stemmer_starts(word, "pem")) {
+        if(strchr("bfv", word[3])) {
+            STEMMER_CAND("", 3);
+        } else if(stemmer_is_vowel(word[3])) {
+            STEMMER_CAND("m", 3);
+            STEMMER_CAND("p", 3);
+        }
+    } else if(stemmer_starts(word, "men") || stemmer_starts(word, "pen")) {
+        if(strchr("cdjsz", word[3])) {
+            STEMMER_CAND("", 3);
+        } else if(stemmer_is_vowel(word[3])) {
+            STEMMER_CAND("n", 3);
+            STEMMER_CAND("t", 3);
+        }
+    } else if((stemmer_starts(word, "me") || stemmer_starts(word, "pe")) && strchr("lmnrwy", word[2])) {
+        STEMMER_CAND("", 2);
+    }
+
+#undef STEMMER_CAND
+
+    return n;
+}
+
+/* stemmer_strip_prefixes: remove at most DEPTH derivation prefixes from the
+ * word WORD until a root word is found; the root word is saved to STEM. It
+ * returns TRUE if the root word is found */
+static int stemmer_strip_prefixes(struct stemmer *s, char *word, int depth, char *stem)
+{
+    char cands[STEMMER_MAX_CANDS][STEMMER_KEY_SIZE];
+    int n = stemmer_prefixes(word, cands);
+
+    int i;
+    for(i = 0; i < n; i++) {
+        if(dict_contains(s->roots, cands[i])) {
+            strcpy(stem, cands[i]);
+            return TRUE;
+        }
+    }
+
+    if(depth > 1) {
+        for(i = 0; i < n; i++) {
+            if(stemmer_strip_prefixes(s, cands[i], depth - 1, stem)) {
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/* stemmer_is_disallowed: check wether the prefix of word WORD can't be
+ * used together with the derivation suffix SUFFIX; e.g. be-...-i */
+static int stemmer_is_disallowed(char *word, char *suffix)
+{
+    if(suffix == NULL) {
+        return FALSE;
+    }
+    if(strcmp(suffix, "i") == 0) {
+        return stemmer_starts(word, "be") || stemmer_starts(word, "ke") || stemmer_starts(word, "se");
+    }
+    if(strcmp(suffix, "an") == 0) {
+        return stemmer_starts(word, "di") || stemmer_starts(word, "me") || stemmer_starts(word, "te");
+    }
+    return stemmer_starts(word, "ke") || stemmer_starts(word, "se");
+}
+
+/* stemmer_run: find the root word of the word WORD and save it to STEM.
+ * WORD is saved as is if the root word is not found */
+static void stemmer_run(struct stemmer *s, char *word, char *stem)
+{
+    strcpy(stem, word);
+    if(strlen(word) < 4 || dict_contains(s->roots, word)) {
+        return;
+    }
+
+    /* Remove the particle then the possessive pronoun */
+    char w[STEMMER_KEY_SIZE];
+    strcpy(w, word);
+    if(stemmer_strip_suffix(w, "lah") || stemmer_strip_suffix(w, "kah") ||
+       stemmer_strip_suffix(w, "tah") || stemmer_strip_suffix(w, "pun")) {
+        if(dict_contains(s->roots, w)) {
+            strcpy(stem, w);
+            return;
+        }
+    }
+    if(stemmer_strip_suffix(w, "nya") || stemmer_strip_suffix(w, "ku") ||
+       stemmer_strip_suffix(w, "mu")) {
+        if(dict_contains(s->roots, w)) {
+            strcpy(stem, w);
+            return;
+        }
+    }
+
+    /* Remove the derivation suffix; keep the word before, in case the
+     * suffix is part of the root word */
+    char base[STEMMER_KEY_SIZE];
+    strcpy(base, w);
+    char *suffix = NULL;
+    if(stemmer_strip_suffix(w, "kan")) {
+        suffix = "kan";
+    } else if(stemmer_strip_suffix(w, "an")) {
+        suffix = "an";
+    } else if(stemmer_strip_suffix(w, "i")) {
+        suffix = "i";
+    }
+    if(suffix && dict_contains(s->roots, w)) {
+        strcpy(stem, w);
+        return;
+    }
+
+    /* Remove the derivation prefixes */
+    if(!stemmer_is_disallowed(w, suffix) && stemmer_strip_prefixes(s, w, STEMMER_MAX_PREFIXES, stem)) {
+        return;
+    }
+    if(suffix) {
+        stemmer_strip_prefixes(s, base, STEMMER_MAX_PREFIXES, stem);
+    }
+}
+
+/* stemmer_stem: get the stem of the token TOKEN. The returned stem lives
+ * in the cache of stemmer S and it's valid until the next call. TOKEN is
+ * returned as is if S is NULL */
+char *stemmer_stem(struct stemmer *s, char *token)
+{
+    if(s == NULL || strlen(token) >= STEMMER_KEY_SIZE) {
+        return token;
+    }
+
+    struct stemmer_entry *e = &s->cache[vocab_hash(DICT_HASH_SEED, token) & (STEMMER_CACHE_SIZE - 1)];
+    if(strcmp(e->token, token) != 0) {
+        /* Miss; replace the entry */
+        strcpy(e->token, token);
+        stemmer_run(s, token, e->stem);
+    }
+    return e->stem;
+}
+
+/* stemmer_destroy: remove stemmer S from memory */
+void stemmer_destroy(struct stemmer *s)
+{
+    if(s == NULL) return;
+    dict_destroy(s->roots);
+    free(s->cache);
+    free(s);
+}
@@ -0,0 +1,62 @@
+/* Sayoeti Stemmer
+ * Indonesian affix stripper in the style of Nazief-Adriani. The particles
+ * (-lah, -kah, -tah, -pun), the possessive pronouns (-ku, -mu, -nya), the
+ * derivation suffixes (-i, -kan, -an) and up to three derivation prefixes
+ * are removed; every candidate is checked in the root words dictionary, so
+ * "dikorupsi", "mengorupsi" and "korupsinya" are all indexed as "korupsi".
+ * The token is kept as is if no root word is found.
+ *
+ * Stemming is expensive compared to the dictionary lookup and the same
+ * surface forms occur again and again, so the stems are memoized in a
+ * bounded direct-mapped cache.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STEMMER_H
+#define STEMMER_H
+
+/* Macros */
+/* A token and its stem fit in one key; tokens are shorter than
+ * MAX_TOKEN_CHAR */
+#define STEMMER_KEY_SIZE 32
+/* Number of entries of the stem cache; power of two */
+#define STEMMER_CACHE_SIZE 4096
+/* Maximum number of derivation prefixes of one word */
+#define STEMMER_MAX_PREFIXES 3
+/* Maximum number of candidates after removing one prefix */
+#define STEMMER_MAX_CANDS 3
+
+/* stemmer_entry: one memoized stem; the entry is empty if TOKEN is empty */
+struct stemmer_entry {
+    char token[STEMMER_KEY_SIZE];
+    char stem[STEMMER_KEY_SIZE];
+};
+
+/* stemmer: represents the stemmer */
+struct stemmer {
+    /* Dictionary of root words; compiled to the trie backend */
+    struct dict *roots;
+
+    /* Stem cache indexed by the hash of the token */
+    struct stemmer_entry *cache;
+};
+
+/* Prototypes */
+struct stemmer *stemmer_new(char *fname);
+char *stemmer_stem(struct stemmer *s, char *token);
+void stemmer_destroy(struct stemmer *s);
+
+#endif
@@ -38,7 +38,7 @@ struct dict *stopw_dict_create(char *fname)
     }
 
     /* Populate dictionary from a file FP */
-    stopw_dict = dict_populatef(fp, NULL, stopw_dict);
+    stopw_dict = dict_populatef(fp, NULL, stopw_dict, NULL);
     if(stopw_dict == NULL) {
         return NULL;
     }
@@ -46,6 +46,12 @@ struct dict *stopw_dict_create(char *fname)
     /* Count document as 1 */
     stopw_dict->ndocs = 1;
 
+    /* Stop words never change; use the trie backend, so the corpus
+     * tokens can be checked while they are read */
+    if(dict_compile(stopw_dict) != 0) {
+        return NULL;
+    }
+
     /* Close the file */
     if(fclose(fp) != 0) {
         return NULL;
@@ -0,0 +1,153 @@
+/* Sayoeti Thread Team
+ * Persistent team of worker threads for the intra-request parallelism.
+ * Starting a thread costs more than a prediction, so the threads are
+ * started once and sleep on a condition variable between the jobs. A job
+ * is one function called once for each thread with the index of the
+ * thread; the caller runs the index 0 itself and waits for the others.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <errno.h>
+
+#include "team.h"
+
+/* team_worker_arg: the team and the index of one worker */
+struct team_worker_arg {
+    struct team *team;
+    int i;
+};
+
+/* team_worker: run the jobs of the team as thread index I */
+static void *team_worker(void *data)
+{
+    struct team_worker_arg *warg = (struct team_worker_arg *)data;
+    struct team *team = warg->team;
+    int i = warg->i;
+    free(warg);
+
+    long generation = 0;
+    pthread_mutex_lock(&team->lock);
+    while(1) {
+        while(team->generation == generation && !team->is_stopped) {
+            pthread_cond_wait(&team->start, &team->lock);
+        }
+        if(team->is_stopped) break;
+        generation = team->generation;
+        team_fn fn = team->fn;
+        void *arg = team->arg;
+        pthread_mutex_unlock(&team->lock);
+
+        fn(arg, i);
+
+        pthread_mutex_lock(&team->lock);
+        team->npending--;
+        if(team->npending == 0) pthread_cond_signal(&team->done);
+    }
+    pthread_mutex_unlock(&team->lock);
+    return NULL;
+}
+
+/* team_new: create a team of NTHREADS threads; the caller of team_run is
+ * one of them, so NTHREADS-1 workers are started. Returns NULL if only if
+ * error happen and ERRNO will be set to last error. */
+struct team *team_new(int nthreads)
+{
+    if(nthreads < 1 || nthreads > TEAM_MAX_THREADS) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct team *team = (struct team *)calloc(1, sizeof(struct team));
+    if(team == NULL) {
+        return NULL;
+    }
+    team->nthreads = nthreads;
+    team->workers = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    if(team->workers == NULL) {
+        free(team);
+        return NULL;
+    }
+    pthread_mutex_init(&team->lock, NULL);
+    pthread_cond_init(&team->start, NULL);
+    pthread_cond_init(&team->done, NULL);
+
+    int i;
+    for(i = 1; i < nthreads; i++) {
+        struct team_worker_arg *warg = (struct team_worker_arg *)malloc(sizeof(struct team_worker_arg));
+        if(warg == NULL) {
+            team->nthreads = i;
+            team_destroy(team);
+            return NULL;
+        }
+        warg->team = team;
+        warg->i = i;
+        int err = pthread_create(&team->workers[i], NULL, team_worker, warg);
+        if(err != 0) {
+            free(warg);
+            team->nthreads = i;
+            team_destroy(team);
+            errno = err;
+            return NULL;
+        }
+    }
+
+    return team;
+}
+
+/* team_run: call FN(ARG, I) for each thread index I of TEAM at once and
+ * wait until all of them return. The index 0 runs in the caller */
+void team_run(struct team *team, team_fn fn, void *arg)
+{
+    if(team->nthreads > 1) {
+        pthread_mutex_lock(&team->lock);
+        team->fn = fn;
+        team->arg = arg;
+        team->npending = team->nthreads - 1;
+        team->generation++;
+        pthread_cond_broadcast(&team->start);
+        pthread_mutex_unlock(&team->lock);
+    }
+
+    fn(arg, 0);
+
+    if(team->nthreads > 1) {
+        pthread_mutex_lock(&team->lock);
+        while(team->npending > 0) {
+            pthread_cond_wait(&team->done, &team->lock);
+        }
+        pthread_mutex_unlock(&team->lock);
+    }
+}
+
+/* team_destroy: stop the workers and remove TEAM from memory */
+void team_destroy(struct team *team)
+{
+    if(team == NULL) return;
+    pthread_mutex_lock(&team->lock);
+    team->is_stopped = 1;
+    pthread_cond_broadcast(&team->start);
+    pthread_mutex_unlock(&team->lock);
+
+    int i;
+    for(i = 1; i < team->nthreads; i++) {
+        pthread_join(team->workers[i], NULL);
+    }
+    pthread_mutex_destroy(&team->lock);
+    pthread_cond_destroy(&team->start);
+    pthread_cond_destroy(&team->done);
+    free(team->workers);
+    free(team);
+}
@@ -0,0 +1,61 @@
+/* Sayoeti Thread Team
+ * Persistent team of worker threads for the intra-request parallelism.
+ * Starting a thread costs more than a prediction, so the threads are
+ * started once and sleep on a condition variable between the jobs. A job
+ * is one function called once for each thread with the index of the
+ * thread; the caller runs the index 0 itself and waits for the others.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TEAM_H
+#define TEAM_H
+
+#include <pthread.h>
+
+/* Macros */
+/* Maximum number of threads of one team */
+#define TEAM_MAX_THREADS 64
+
+/* team_fn: the job of the team; called with ARG and the thread index I */
+typedef void (*team_fn)(void *arg, int i);
+
+/* team: represents the thread pool */
+struct team {
+    /* Number of threads including the caller and the workers */
+    int nthreads;
+    pthread_t *workers;
+
+    /* The current job; GENERATION is incremented for each job so the
+     * workers know there is a new one. NPENDING is the number of workers
+     * that haven't finished it yet */
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    team_fn fn;
+    void *arg;
+    long generation;
+    int npending;
+
+    /* The workers exit at the next job */
+    int is_stopped;
+};
+
+/* Prototypes */
+struct team *team_new(int nthreads);
+void team_run(struct team *team, team_fn fn, void *arg);
+void team_destroy(struct team *team);
+
+#endif
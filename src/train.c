@@ -20,40 +20,46 @@
 #include <math.h>
 
 #include "dict.h"
+#include "vocab.h"
 #include "corpus.h"
 #include "train.h"
 
-/* train_node_create: create SVM node for each term in document root */
-void train_node_create(int *svmni, int ndocs, struct corpus_doc *cdoc,
-    struct corpus_doc_item *root, struct dict *index, struct svm_node *svmns)
+/* train_node_create: create SVM node for each term in document CDOC and
+ * save them to SVMNS terminated by index -1. The IDF of each term is taken
+ * from the dense IDF table of frozen vocabulary VOCAB by its term id; it's
+ * computed once when the vocabulary is frozen and stored in the snapshot.
+ * SVMNS may be CDOC->nodes to weight the document in place. It returns the
+ * number of nodes without the terminator */
+int train_node_create(struct corpus_doc *cdoc, struct vocab *vocab, struct svm_node *svmns)
 {
-    if(root == NULL) return;
-    if(root->left) train_node_create(svmni, ndocs, cdoc, root->left, index, svmns);
+    const struct svm_node *nodes = cdoc->nodes;
+    const double *idfs = vocab->idfs;
+    int nitems = (int)cdoc->nitems;
 
-    /* Get the term from index vocab */
-    struct dict_item *item = dict_item_search(index->root, root->term);
+    /* TF is normalized by the number of unique terms in the document; take
+     * the reciprocal once, so the weight of each term is only multiplies */
+    double scale = 1.0/nitems;
 
-    /* compute the TF-IDF weight */
-    double tf = (double)root->frequency/cdoc->nitems;
-    double idf = log((double)ndocs/(item->ndocs));
-    // printf("DEBUG %s \"%s\" f %d nitems %li tf: %f - ndocs %d item->ndocs %d idf %f tf-idf %f\n",
-    //     cdoc->path, root->term, root->frequency, cdoc->nitems, tf, ndocs, item->ndocs, idf, tf * idf);
-
-    /* Save to the array of svm node */
-    struct svm_node svmn = {root->index, tf*idf};
-    svmns[*svmni] = svmn;
-
-    /* Increase the svm node index */
-    *svmni += 1;
+    int svmni;
+    for(svmni = 0; svmni < nitems; svmni++) {
+        int index = nodes[svmni].index;
+        svmns[svmni].index = index;
+        svmns[svmni].value = nodes[svmni].value*scale*idfs[index];
+    }
 
-    if(root->right) train_node_create(svmni, ndocs, cdoc, root->right, index, svmns);
+    /* Terminate the SVM node */
+    svmns[svmni].index = -1;
+    svmns[svmni].value = 0;
 
-    return;
+    return svmni;
 }
 
 /* train_problem_create: create SVM problem based on collection of copus 
- * documents CDOCS and index vocabulary INDEX */
-struct svm_problem *train_problem_create(int ndocs, struct corpus_doc **cdocs, struct dict *index)
+ * documents CDOCS and frozen vocabulary VOCAB. The nodes of all documents
+ * are stored in one contiguous block (CSR); row CDI starts at x[CDI] and
+ * ends at its terminator, so the kernel evaluations of the solver stream
+ * through memory. */
+struct svm_problem *train_problem_create(int ndocs, struct corpus_doc **cdocs, struct vocab *vocab)
 {
     /* Allocate memory for new problem */
     struct svm_problem *svmp = (struct svm_problem *)malloc(sizeof(struct svm_problem));
@@ -66,28 +72,35 @@ struct svm_problem *train_problem_create(int ndocs, struct corpus_doc **cdocs, s
     svmp->y = (double *)malloc(ndocs * sizeof(double));
     if(svmp->y == NULL) return NULL;
     
-    /* Allocate memory for the array of svm_node array */
+    /* Allocate memory for the row pointers */
     svmp->x = (struct svm_node **)malloc(ndocs * sizeof(struct svm_node *));
     if(svmp->x == NULL) return NULL;
 
+    /* Count the nodes of all rows; each row has one extra node for the
+     * terminator */
+    long nnodes = 0;
     int cdi;
+    for(cdi = 0; cdi < ndocs; cdi++) {
+        nnodes += cdocs[cdi]->nitems + 1;
+    }
+
+    /* Allocate the node block once; it's aligned to the cache line. The
+     * block lives as long as the model, the support vectors point into it */
+    void *block = NULL;
+    if(posix_memalign(&block, TRAIN_ALIGN, nnodes * sizeof(struct svm_node)) != 0) {
+        return NULL;
+    }
+    struct svm_node *svmns = (struct svm_node *)block;
+
     for(cdi = 0; cdi < ndocs; cdi++) {
         /* Because this is a ONE_CLASS SVM we just set the label of training 
          * data to 1 */
         svmp->y[cdi] = 1;
 
-        /* Allocate memory for the svm_node array */
-        struct svm_node *svmns = (struct svm_node *)malloc((cdocs[cdi]->nitems+1) * sizeof(struct svm_node));
-        if(svmns == NULL) return NULL;
-        /* Create svm node for each term in document */
-        int svmni = 0; /* keep track the index of svm node */
-        train_node_create(&svmni, ndocs, cdocs[cdi], cdocs[cdi]->root, index, svmns);
-
-        /* Terminate the SVM node; Allocate memory for SVM node */
-        struct svm_node svmn = {-1, 0};
-        svmns[svmni] = svmn;
-
+        /* Create svm node for each term in document; the next row starts
+         * right after the terminator */
         svmp->x[cdi] = svmns;
+        svmns += train_node_create(cdocs[cdi], vocab, svmns) + 1;
     }
 
     return svmp;
@@ -20,13 +20,12 @@
 #define TRAIN_H
 #include "../deps/libsvm/svm.h"
 
+/* Macros */
+/* Alignment of the training node block */
+#define TRAIN_ALIGN 64
+
 /* Prototypes */
-struct svm_problem *train_problem_create(int ndocs, struct corpus_doc **cdocs, struct dict *index);
-void train_node_create(int *svmni, 
-                       int ndocs, 
-                       struct corpus_doc *cdoc,
-                       struct corpus_doc_item *root, 
-                       struct dict *index, 
-                       struct svm_node *svmns);
+struct svm_problem *train_problem_create(int ndocs, struct corpus_doc **cdocs, struct vocab *vocab);
+int train_node_create(struct corpus_doc *cdoc, struct vocab *vocab, struct svm_node *svmns);
 
-#endif
\ No newline at end of file
+#endif
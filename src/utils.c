@@ -19,14 +19,20 @@
 #include <ctype.h>
 
 #include "utils.h"
+#include "dict.h"
+#include "dat.h"
 
 /* util_tokenf: get each word separated by space on the file FP.
  * It returns 0 if the EOF is reached and it's guarantee that
- * no token with length more that MAXTOKEN are returned */
-int util_tokenf(char token[], int maxtoken, FILE *fp)
+ * no token with length more that MAXTOKEN are returned. If TRIE is not
+ * NULL the token is also resolved in it while we scan the characters;
+ * ID is set to the index of the token in TRIE or -1 if it's not exists,
+ * so no lookup is needed after the token is read */
+int util_tokenf(char token[], int maxtoken, FILE *fp, struct dat *trie, long *id)
 {
-    /* Keep track the token index */
+    /* Keep track the token index and the state of the trie */
     int ti = 0;
+    long state = trie ? DAT_ROOT : -1;
 
     /* Read all char C before space */
     int c;
@@ -41,6 +47,7 @@ int util_tokenf(char token[], int maxtoken, FILE *fp)
              * and get the next one */
             if(ti > maxtoken-1) {
                 ti = 0;
+                if(trie) state = DAT_ROOT;
                 continue;
             }
 
@@ -49,9 +56,11 @@ int util_tokenf(char token[], int maxtoken, FILE *fp)
             break;
         }
 
-        /* Save the current character C to token TOKEN */
+        /* Save the current character C to token TOKEN and walk the trie;
+         * once we fall out of the trie we stay out */
         if(isalnum(c) && (ti < maxtoken-1)) {
             token[ti] = tolower(c);
+            if(state >= 0) state = dat_walk(trie, state, token[ti]);
         }
 
         /* Increase the index of token */
@@ -59,8 +68,10 @@ int util_tokenf(char token[], int maxtoken, FILE *fp)
     }
     
     /* Terminate the current token */
+    if(trie) *id = -1;
     if(ti > 0 && ti < maxtoken-1) {
         token[ti] = '\0';
+        if(state >= 0) *id = dat_value(trie, state);
     }
 
     return ti;
@@ -19,8 +19,10 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+struct dat;
+
 /* Prototypes */
-int util_tokenf(char token[], int maxtoken, FILE *fp);
+int util_tokenf(char token[], int maxtoken, FILE *fp, struct dat *trie, long *id);
 int util_tokenb(char token[], int maxtoken, int indexbuf, char *buffer);
 int util_max(int a, int b);
 
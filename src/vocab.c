@@ -0,0 +1,632 @@
+/* Sayoeti Frozen Vocabulary
+ * Read-only representation of the index vocabulary for the serving phase.
+ * Once the index vocabulary is created and the IDF of each term is computed,
+ * the vocabulary never changes. So we freeze it into a minimal perfect hash
+ * table (CHD; compress, hash and displace) with a packed term-string blob to
+ * verify the hit and a parallel array of term id, and the IDF of each term
+ * indexed by term id. A Bloom filter in front of the hash rejects most of
+ * the unknown terms in one cache line.
+ *
+ * The frozen vocabulary lives in one contiguous memory block, so it can be
+ * written as is to a file and mapped back with mmap(2).
+ *
+ * In the hashed mode each token is mapped to its id by a signed hash
+ * modulo 2^HASHBITS and only the IDF of each id is kept; the terms of the
+ * table are the stop words, which the requests skip.
+ *
+ * The word n-grams are hashed from the term ids of their words to one of
+ * 2^NGRAMBITS ids after the term ids; only the IDF of each id is kept.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dict.h"
+#include "vocab.h"
+#include "stemmer.h"
+
+/* vocab_mix: finalizer of the hash; spread every input bit to all
+ * output bits (MurmurHash3 fmix64) */
+uint64_t vocab_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* FNV-1a; the hash is updated one character at a time, so the tokenizer
+ * can hash the token while scanning it */
+#define VOCAB_HASH_INIT(seed) (0xcbf29ce484222325ULL ^ (seed))
+#define VOCAB_HASH_STEP(h, c) (((h) ^ (unsigned char)(c)) * 0x100000001b3ULL)
+
+/* vocab_hash: hash the term TERM using FNV-1a seeded by SEED; the hash of
+ * every term in sayoeti, including the Bloom filters and the stem cache */
+uint64_t vocab_hash(uint64_t seed, char *term)
+{
+    uint64_t h = VOCAB_HASH_INIT(seed);
+    while(*term) {
+        h = VOCAB_HASH_STEP(h, *term++);
+    }
+    return vocab_mix(h);
+}
+
+/* vocab_place: get the slot of the hash H displaced by D in the table of
+ * N slots. The displacement D encodes the pair (D / N, D % N). */
+static long vocab_place(uint64_t h, uint64_t d, long n)
+{
+    uint64_t g = vocab_mix(h ^ 0x9e3779b97f4a7c15ULL);
+    uint64_t f1 = (g & 0xffffffff) % n;
+    uint64_t f2 = (g >> 32) % n;
+    return (long)((f1 + (d / n) * f2 + (d % n)) % n);
+}
+
+/* vocab_nids: the number of term ids of the vocabulary with N terms,
+ * HASHBITS bits of hashed ids and the n-grams up to NGRAMS words in
+ * NGRAMBITS bits */
+static long vocab_nids(long n, int hashbits, int ngrams, int ngrambits)
+{
+    long nunigrams = hashbits ? (1L << hashbits) : n;
+    return nunigrams + (ngrams > 1 ? (1L << ngrambits) : 0);
+}
+
+/* vocab_memsize: the size of memory block for N terms, NB buckets, NBLOCKS
+ * blocks of Bloom filter, LENBLOB bytes of terms and NIDS term ids */
+static size_t vocab_memsize(long n, long nb, long nblocks, long lenblob, long nids)
+{
+    return sizeof(struct vocab_header)
+        + nblocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t)
+        + (nids + 1) * sizeof(double)
+        + nb * sizeof(uint32_t)
+        + n * sizeof(uint32_t)
+        + n * sizeof(int32_t)
+        + lenblob;
+}
+
+/* vocab_header_valid: check the header HDR of the frozen vocabulary file
+ * of SIZE bytes. Every count must fit in the file, so the size can't
+ * overflow, and a vocabulary with terms must have buckets and a filter.
+ * It returns TRUE if the header is valid, otherwise FALSE */
+static int vocab_header_valid(struct vocab_header *hdr, size_t size)
+{
+    if(memcmp(hdr->magic, VOCAB_MAGIC, sizeof(hdr->magic)) != 0) return FALSE;
+    if(hdr->nitems < 0 || hdr->nbuckets < 0 || hdr->ndocs < 0 || hdr->lenblob < 0 || hdr->nblocks < 0) {
+        return FALSE;
+    }
+    if((size_t)hdr->nitems > size || (size_t)hdr->nbuckets > size || (size_t)hdr->lenblob > size ||
+       (size_t)hdr->nblocks > size) {
+        return FALSE;
+    }
+    if(hdr->nitems > 0 && (hdr->nbuckets == 0 || hdr->nblocks == 0)) return FALSE;
+    if(hdr->hashbits > VOCAB_MAX_HASHBITS) return FALSE;
+    if(hdr->ngrams < 1 || hdr->ngrams > VOCAB_MAX_NGRAMS || hdr->ngrambits > VOCAB_MAX_HASHBITS) {
+        return FALSE;
+    }
+    return vocab_memsize(hdr->nitems, hdr->nbuckets, hdr->nblocks, hdr->lenblob,
+                         vocab_nids(hdr->nitems, hdr->hashbits, hdr->ngrams, hdr->ngrambits)) == size;
+}
+
+/* vocab_layout: point every array of the frozen vocabulary V inside
+ * its memory block */
+static void vocab_layout(struct vocab *v)
+{
+    struct vocab_header *hdr = (struct vocab_header *)v->mem;
+    v->nitems = hdr->nitems;
+    v->nbuckets = hdr->nbuckets;
+    v->ndocs = hdr->ndocs;
+    v->seed = hdr->seed;
+    v->flags = hdr->flags;
+    v->hashbits = hdr->hashbits;
+    v->ngrams = hdr->ngrams;
+    v->ngrambits = hdr->ngrambits;
+    v->nunigrams = vocab_nids(hdr->nitems, hdr->hashbits, 1, 0);
+    v->nids = vocab_nids(hdr->nitems, hdr->hashbits, hdr->ngrams, hdr->ngrambits);
+
+    /* The filter comes first; the header is 64 bytes so each block is
+     * aligned to the cache line */
+    char *p = (char *)v->mem + sizeof(struct vocab_header);
+    v->filter.nblocks = hdr->nblocks;
+    v->filter.capacity = hdr->nitems;
+    v->filter.bits = (uint64_t *)p;
+    p += hdr->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+    v->idfs = (double *)p;
+    p += (v->nids + 1) * sizeof(double);
+    v->disps = (uint32_t *)p;
+    p += v->nbuckets * sizeof(uint32_t);
+    v->offsets = (uint32_t *)p;
+    p += v->nitems * sizeof(uint32_t);
+    v->ids = (int32_t *)p;
+    p += v->nitems * sizeof(int32_t);
+    v->blob = p;
+}
+
+/* vocab_items_collect: collect all items of the dictionary ROOT to ITEMS
+ * in alphabetical order */
+static void vocab_items_collect(struct dict_item *root, struct dict_item **items, long *n)
+{
+    if(root == NULL) return;
+    vocab_items_collect(root->left, items, n);
+    items[*n] = root;
+    *n += 1;
+    vocab_items_collect(root->right, items, n);
+}
+
+/* vocab_displace: find the displacement of each bucket so every hash in
+ * HASHES gets its own slot. It returns 0 on success and -1 if we can't find
+ * the displacements with the current seed. */
+static int vocab_displace(long n, long nb, uint64_t *hashes, uint32_t *disps, long *slots)
+{
+    int status = -1;
+    long *sizes = (long *)calloc(nb + 1, sizeof(long));
+    long *starts = (long *)calloc(nb + 1, sizeof(long));
+    long *members = (long *)malloc(n * sizeof(long));
+    long *order = (long *)malloc(nb * sizeof(long));
+    char *taken = (char *)calloc(n, sizeof(char));
+    if(sizes == NULL || starts == NULL || members == NULL || order == NULL || taken == NULL) {
+        goto done;
+    }
+
+    /* Group the hashes by bucket */
+    long i, b;
+    for(i = 0; i < n; i++) sizes[hashes[i] % nb] += 1;
+    for(b = 0; b < nb; b++) starts[b+1] = starts[b] + sizes[b];
+    long *fill = order; /* reuse ORDER as fill pointer */
+    for(b = 0; b < nb; b++) fill[b] = starts[b];
+    for(i = 0; i < n; i++) {
+        b = hashes[i] % nb;
+        members[fill[b]++] = i;
+    }
+
+    /* Place the biggest buckets first; they are the hardest to place.
+     * Bucket sizes are small, so we order the buckets by counting */
+    long maxsize = 0, size, oi = 0;
+    for(b = 0; b < nb; b++) maxsize = (sizes[b] > maxsize) ? sizes[b] : maxsize;
+    for(size = maxsize; size > 0; size--) {
+        for(b = 0; b < nb; b++) {
+            if(sizes[b] == size) order[oi++] = b;
+        }
+    }
+    for(b = 0; b < nb; b++) disps[b] = 0;
+
+    long nfilled = oi;
+    for(oi = 0; oi < nfilled; oi++) {
+        b = order[oi];
+        size = sizes[b];
+        long *m = members + starts[b];
+
+        /* Two equal hashes in the same bucket will never get separated */
+        long j, k;
+        for(j = 0; j < size; j++) {
+            for(k = 0; k < j; k++) {
+                if(hashes[m[j]] == hashes[m[k]]) goto done;
+            }
+        }
+
+        /* Try every displacement until all members of the bucket fall
+         * into free and distinct slots */
+        uint64_t d, limit = (uint64_t)n * 32;
+        if(limit > UINT32_MAX) limit = UINT32_MAX;
+        for(d = 0; d < limit; d++) {
+            int ok = TRUE;
+            for(j = 0; j < size && ok; j++) {
+                slots[m[j]] = vocab_place(hashes[m[j]], d, n);
+                if(taken[slots[m[j]]]) ok = FALSE;
+                for(k = 0; k < j && ok; k++) {
+                    if(slots[m[k]] == slots[m[j]]) ok = FALSE;
+                }
+            }
+            if(ok) break;
+        }
+        if(d == limit) goto done;
+
+        disps[b] = (uint32_t)d;
+        for(j = 0; j < size; j++) taken[slots[m[j]]] = TRUE;
+    }
+    status = 0;
+
+done:
+    free(sizes);
+    free(starts);
+    free(members);
+    free(order);
+    free(taken);
+    return status;
+}
+
+/* vocab_build: build the frozen vocabulary of the terms of dictionary
+ * TERMS (NULL for no terms) with HASHBITS bits of hashed ids, the n-grams
+ * up to NGRAMS words in NGRAMBITS bits, NDOCS source documents and VOCAB_*
+ * flags FLAGS. The IDF of each term is computed from its number of
+ * documents; the terms of the hashed vocabulary have no ids nor IDF.
+ * Returns NULL if only if error happen and ERRNO will be set to last
+ * error. */
+static struct vocab *vocab_build(struct dict *terms, int hashbits, int ngrams, int ngrambits, long ndocs,
+    long flags)
+{
+    long n = terms ? terms->nitems : 0;
+    long nb = n / VOCAB_BUCKET_SIZE + 1;
+
+    struct vocab *v = (struct vocab *)malloc(sizeof(struct vocab));
+    struct dict_item **items = (struct dict_item **)malloc((n + 1) * sizeof(struct dict_item *));
+    uint64_t *hashes = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+    long *slots = (long *)malloc((n + 1) * sizeof(long));
+    uint32_t *disps = (uint32_t *)malloc(nb * sizeof(uint32_t));
+    if(v == NULL || items == NULL || hashes == NULL || slots == NULL || disps == NULL) {
+        goto fail;
+    }
+
+    /* Get all the terms and the size of the blob */
+    long ni = 0;
+    if(terms) vocab_items_collect(terms->root, items, &ni);
+    long i, lenblob = 0;
+    for(i = 0; i < n; i++) {
+        lenblob += strlen(items[i]->term) + 1;
+    }
+
+    /* Find the seed that gives us a perfect hash */
+    uint64_t seed = 0;
+    if(n > 0) {
+        for(seed = 0; seed < VOCAB_MAX_SEEDS; seed++) {
+            for(i = 0; i < n; i++) hashes[i] = vocab_hash(seed, items[i]->term);
+            if(vocab_displace(n, nb, hashes, disps, slots) == 0) break;
+        }
+        if(seed == VOCAB_MAX_SEEDS) {
+            errno = EAGAIN;
+            goto fail;
+        }
+    } else {
+        disps[0] = 0;
+    }
+
+    /* Allocate the memory block aligned to the cache line and fill
+     * the header */
+    long nblocks = bloom_nblocks(n);
+    long nids = vocab_nids(n, hashbits, ngrams, ngrambits);
+    v->lenmem = vocab_memsize(n, nb, nblocks, lenblob, nids);
+    if(posix_memalign(&v->mem, 64, v->lenmem) != 0) {
+        goto fail;
+    }
+    memset(v->mem, 0, v->lenmem);
+    v->is_mapped = FALSE;
+
+    struct vocab_header *hdr = (struct vocab_header *)v->mem;
+    memcpy(hdr->magic, VOCAB_MAGIC, sizeof(hdr->magic));
+    hdr->seed = seed;
+    hdr->nitems = n;
+    hdr->nbuckets = nb;
+    hdr->ndocs = ndocs;
+    hdr->lenblob = lenblob;
+    hdr->nblocks = nblocks;
+    hdr->flags = flags;
+    hdr->hashbits = hashbits;
+    hdr->ngrams = ngrams;
+    hdr->ngrambits = ngrambits;
+    vocab_layout(v);
+
+    /* Fill each slot */
+    memcpy(v->disps, disps, nb * sizeof(uint32_t));
+    uint32_t offset = 0;
+    for(i = 0; i < n; i++) {
+        long slot = slots[i];
+        v->offsets[slot] = offset;
+        if(hashbits) {
+            v->ids[slot] = -1;
+        } else {
+            v->ids[slot] = (int32_t)items[i]->index;
+            v->idfs[items[i]->index] = log((double)ndocs/(items[i]->ndocs));
+        }
+        strcpy(v->blob + offset, items[i]->term);
+        offset += strlen(items[i]->term) + 1;
+        bloom_add(&v->filter, hashes[i]);
+    }
+
+    free(items);
+    free(hashes);
+    free(slots);
+    free(disps);
+    return v;
+
+fail:
+    free(v);
+    free(items);
+    free(hashes);
+    free(slots);
+    free(disps);
+    return NULL;
+}
+
+/* vocab_freeze: freeze the index vocabulary INDEX with VOCAB_* flags FLAGS.
+ * The IDF of each term is computed from its number of documents. If NGRAMS
+ * is more than 1, DFS is the number of documents of each n-gram id in
+ * NGRAMBITS bits after the term ids. Returns NULL if only if error happen
+ * and ERRNO will be set to last error. */
+struct vocab *vocab_freeze(struct dict *index, long flags, int ngrams, int ngrambits, int *dfs)
+{
+    struct vocab *v = vocab_build(index, 0, ngrams, ngrambits, index->ndocs, flags);
+    if(v == NULL) {
+        return NULL;
+    }
+
+    /* The n-grams that never occur get no weight */
+    long id;
+    for(id = v->nunigrams + 1; id <= v->nids; id++) {
+        v->idfs[id] = dfs[id] ? log((double)v->ndocs/dfs[id]) : VOCAB_UNSEEN;
+    }
+
+    return v;
+}
+
+/* vocab_hashed: create the hashed vocabulary with 2^HASHBITS term ids and
+ * VOCAB_* flags FLAGS; the n-grams up to NGRAMS words get 2^NGRAMBITS ids
+ * after them. DFS is the number of documents of each id out of NDOCS
+ * documents. The words of EXC dictionary (NULL for none) are kept as the
+ * terms, so the requests skip them like the source documents did. Returns
+ * NULL if only if error happen and ERRNO will be set to last error. */
+struct vocab *vocab_hashed(int hashbits, long ndocs, int *dfs, long flags, int ngrams, int ngrambits,
+    struct dict *exc)
+{
+    struct vocab *v = vocab_build(exc, hashbits, ngrams, ngrambits, ndocs, flags);
+    if(v == NULL) {
+        return NULL;
+    }
+
+    /* The ids that never occur get no weight */
+    long id;
+    for(id = 1; id <= v->nids; id++) {
+        v->idfs[id] = dfs[id] ? log((double)ndocs/dfs[id]) : VOCAB_UNSEEN;
+    }
+
+    return v;
+}
+
+/* vocab_hashed_id: get the id of the hash H in HASHBITS bits; the sign is
+ * taken from the highest bit, so the collisions cancel out on average */
+static long vocab_hashed_id(uint64_t h, int hashbits, int *sign)
+{
+    *sign = (h >> 63) ? -1 : 1;
+    return (long)(h & ((1UL << hashbits) - 1)) + 1;
+}
+
+/* vocab_hash_id: get the hashed id of the term TERM in HASHBITS bits and
+ * its sign; the ids start from 1 */
+long vocab_hash_id(int hashbits, char *term, int *sign)
+{
+    return vocab_hashed_id(vocab_hash(VOCAB_HASHED_SEED, term), hashbits, sign);
+}
+
+/* vocab_ngram_id: get the id of the n-gram of N term ids IDS in NGRAMBITS
+ * bits after the id BASE and its sign. The ids are hashed together with N,
+ * so the n-grams of different length don't share the ids on purpose */
+long vocab_ngram_id(long base, int ngrambits, long *ids, int n, int *sign)
+{
+    uint64_t h = VOCAB_HASH_INIT(VOCAB_HASHED_SEED ^ (uint64_t)n);
+    int i;
+    for(i = 0; i < n; i++) {
+        uint64_t x = (uint64_t)ids[i];
+        int b;
+        for(b = 0; b < 4; b++) {
+            h = VOCAB_HASH_STEP(h, x >> (b * 8));
+        }
+    }
+    return base + vocab_hashed_id(vocab_mix(h), ngrambits, sign);
+}
+
+/* vocab_resolve: get the slot of the term with hash H. The term is verified
+ * against the LEN characters of TERM compared in lower case. It returns -1
+ * if the term is not exists in vocabulary V */
+static long vocab_resolve(struct vocab *v, uint64_t h, char *term, int len)
+{
+    if(v->nitems == 0) return -1;
+
+    /* Most of the unknown terms stop here */
+    if(!bloom_check(&v->filter, h)) return -1;
+
+    /* Every term maps to some slot; verify that it's our term */
+    long slot = vocab_place(h, v->disps[h % v->nbuckets], v->nitems);
+    char *s = v->blob + v->offsets[slot];
+    int i;
+    for(i = 0; i < len; i++) {
+        if(s[i] != tolower((unsigned char)term[i])) return -1;
+    }
+    if(s[len] != '\0') return -1;
+
+    return slot;
+}
+
+/* vocab_search: search the term TERM in the frozen vocabulary V. It returns
+ * the slot of the term or -1 if the term is not exists in vocabulary */
+long vocab_search(struct vocab *v, char *term)
+{
+    return vocab_resolve(v, vocab_hash(v->seed, term), term, strlen(term));
+}
+
+/* vocab_tokenb: get each word separated by space from the BUFFER and resolve
+ * it in frozen vocabulary V in the same pass; the token is hashed while we
+ * scan it and it's never copied. If stemmer S is not NULL, the token is
+ * copied and its stem is resolved instead. ID is set to the term id of the
+ * token or -1 if the token is not exists in V or it's one of the skipped
+ * words of the hashed vocabulary; SIGN is set to the sign of the hashed id
+ * or 1. It follows util_tokenb; it returns the last accessed index buffer
+ * and the buffer is terminated by '\r'. */
+int vocab_tokenb(struct vocab *v, struct stemmer *s, long *id, int *sign, int indexbuf, char *buffer)
+{
+    /* Keep track the length and the start of token. H is the hash of the
+     * terms of V and HH is the hash of the hashed ids */
+    int ti = 0;
+    int start = indexbuf;
+    uint64_t h = VOCAB_HASH_INIT(v->seed);
+    uint64_t hh = VOCAB_HASH_INIT(VOCAB_HASHED_SEED);
+    char token[MAX_TOKEN_CHAR];
+
+    /* Read each char until '\r' */
+    int c;
+    while((c = (unsigned char)buffer[indexbuf]) != '\r') {
+        /* Stop reading if we encounter a space */
+        if(!isalnum(c)) {
+            /* But we keep reading if we don't get any token yet */
+            if(ti == 0) {
+                indexbuf += 1;
+                continue;
+            }
+
+            /* If the token length is exceeded, throw the token, 
+             * and get the next one */
+            if(ti > MAX_TOKEN_CHAR-1) {
+                ti = 0;
+                h = VOCAB_HASH_INIT(v->seed);
+                hh = VOCAB_HASH_INIT(VOCAB_HASHED_SEED);
+                indexbuf += 1;
+                continue;
+            }
+
+            /* If token is fine, then we stop reading */
+            break;
+        }
+
+        /* Hash the current character C */
+        if(ti == 0) start = indexbuf;
+        if(ti < MAX_TOKEN_CHAR-1) {
+            h = VOCAB_HASH_STEP(h, tolower(c));
+            if(v->hashbits) hh = VOCAB_HASH_STEP(hh, tolower(c));
+            if(s) token[ti] = tolower(c);
+        }
+
+        /* Increase the index of token and buffer */
+        ti++;
+        indexbuf += 1;
+    }
+
+    /* Resolve the token */
+    *id = -1;
+    *sign = 1;
+    if(ti > 0 && ti < MAX_TOKEN_CHAR-1) {
+        /* The terms of the hashed vocabulary are the skipped words; they
+         * are checked before the stemming like in the source documents */
+        if(v->hashbits) {
+            if(vocab_resolve(v, vocab_mix(h), buffer + start, ti) >= 0) {
+                return indexbuf;
+            }
+            if(s) {
+                token[ti] = '\0';
+                *id = vocab_hash_id(v->hashbits, stemmer_stem(s, token), sign);
+            } else {
+                *id = vocab_hashed_id(vocab_mix(hh), v->hashbits, sign);
+            }
+            return indexbuf;
+        }
+
+        long slot;
+        if(s) {
+            token[ti] = '\0';
+            slot = vocab_search(v, stemmer_stem(s, token));
+        } else {
+            slot = vocab_resolve(v, vocab_mix(h), buffer + start, ti);
+        }
+        if(slot >= 0) *id = v->ids[slot];
+    }
+
+    /* Return the last index of accessed buffer */
+    return indexbuf;
+}
+
+/* vocab_save: write the frozen vocabulary V to the file PATH. It returns 0
+ * on success, otherwise -1 and ERRNO will be set to last error. */
+int vocab_save(struct vocab *v, char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL) {
+        return -1;
+    }
+
+    if(fwrite(v->mem, 1, v->lenmem, fp) != v->lenmem) {
+        fclose(fp);
+        return -1;
+    }
+
+    if(fclose(fp) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* vocab_load: map the frozen vocabulary from file PATH. Returns NULL if
+ * only if error happen and ERRNO will be set to last error. */
+struct vocab *vocab_load(char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    /* Make sure that this is our file and it's not truncated before we
+     * map it */
+    struct vocab_header hdr;
+    if((size_t)st.st_size < sizeof(struct vocab_header) ||
+       pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+       !vocab_header_valid(&hdr, st.st_size)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+        return NULL;
+    }
+
+    struct vocab *v = (struct vocab *)malloc(sizeof(struct vocab));
+    if(v == NULL) {
+        munmap(mem, st.st_size);
+        return NULL;
+    }
+
+    v->mem = mem;
+    v->lenmem = st.st_size;
+    v->is_mapped = TRUE;
+    vocab_layout(v);
+
+    return v;
+}
+
+/* vocab_destroy: remove frozen vocabulary V from memory */
+void vocab_destroy(struct vocab *v)
+{
+    if(v == NULL) return;
+
+    if(v->is_mapped) {
+        munmap(v->mem, v->lenmem);
+    } else {
+        free(v->mem);
+    }
+    free(v);
+}
@@ -0,0 +1,155 @@
+/* Sayoeti Frozen Vocabulary
+ * Read-only representation of the index vocabulary for the serving phase.
+ * Once the index vocabulary is created and the IDF of each term is computed,
+ * the vocabulary never changes. So we freeze it into a minimal perfect hash
+ * table (CHD; compress, hash and displace) with a packed term-string blob to
+ * verify the hit and a parallel array of term id, and the IDF of each term
+ * indexed by term id. A Bloom filter in front of the hash rejects most of
+ * the unknown terms in one cache line.
+ *
+ * The frozen vocabulary lives in one contiguous memory block, so it can be
+ * written as is to a file and mapped back with mmap(2).
+ *
+ * In the hashed mode each token is mapped to its id by a signed hash
+ * modulo 2^HASHBITS and only the IDF of each id is kept; the terms of the
+ * table are the stop words, which the requests skip.
+ *
+ * The word n-grams are hashed from the term ids of their words to one of
+ * 2^NGRAMBITS ids after the term ids; only the IDF of each id is kept.
+ *
+ * Copyright 2015 Bayu Aldi Yansyah <bayualdiyansyah@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VOCAB_H
+#define VOCAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bloom.h"
+
+struct dict;
+struct stemmer;
+
+/* Macros */
+#define VOCAB_MAGIC "SYVOCAB5"
+/* Average number of terms in one bucket of the hash */
+#define VOCAB_BUCKET_SIZE 4
+/* Number of seeds we try before we give up building the hash */
+#define VOCAB_MAX_SEEDS 16
+/* The terms are stemmed; the tokens must be stemmed before lookup */
+#define VOCAB_STEMMED 1
+/* Seed of the hash of the hashed mode; the ids must not change */
+#define VOCAB_HASHED_SEED 0
+/* Maximum number of bits of the hashed ids */
+#define VOCAB_MAX_HASHBITS 28
+/* Maximum length of the word n-grams */
+#define VOCAB_MAX_NGRAMS 4
+/* IDF of the ids that never occur in the source documents */
+#define VOCAB_UNSEEN -1.0
+
+/* vocab_header: the first bytes of the frozen vocabulary memory block.
+ * All the fields have fixed width so the file is portable across the
+ * x86_64 machines. */
+struct vocab_header {
+    char magic[8];
+
+    /* Seed of the hash function */
+    uint64_t seed;
+
+    /* Number of terms, number of buckets and number of source documents */
+    int64_t nitems;
+    int64_t nbuckets;
+    int64_t ndocs;
+
+    /* Size of the term-string blob in bytes */
+    int64_t lenblob;
+
+    /* Number of blocks of the Bloom filter */
+    int64_t nblocks;
+
+    /* VOCAB_* flags and the number of bits of the hashed ids; 0 if the
+     * terms are not hashed. The maximum length of the word n-grams and
+     * the number of bits of their ids; 1 if there are no n-grams. Keep
+     * the header 64 bytes */
+    int32_t flags;
+    uint8_t hashbits;
+    uint8_t ngrams;
+    uint8_t ngrambits;
+    uint8_t reserved;
+};
+
+/* vocab: represents the frozen vocabulary. Every array below points
+ * inside the memory block MEM. */
+struct vocab {
+    /* Number of terms, buckets and source documents; copied from the
+     * header for convenience */
+    long nitems;
+    long nbuckets;
+    long ndocs;
+    uint64_t seed;
+    long flags;
+
+    /* Number of bits of the hashed ids and the number of ids; NIDS is
+     * NITEMS if the terms are not hashed */
+    int hashbits;
+    long nids;
+
+    /* Maximum length of the word n-grams and the number of bits of
+     * their ids; the n-gram ids start after the id NUNIGRAMS */
+    int ngrams;
+    int ngrambits;
+    long nunigrams;
+
+    /* Bloom filter of all terms */
+    struct bloom filter;
+
+    /* IDF of each term indexed by term id; term ids start from 1. It's
+     * VOCAB_UNSEEN if the id never occurs */
+    double *idfs;
+
+    /* Displacement of each bucket */
+    uint32_t *disps;
+
+    /* Offset of the term in BLOB for each slot */
+    uint32_t *offsets;
+
+    /* Term id (index in the index vocabulary) for each slot */
+    int32_t *ids;
+
+    /* Packed NUL-terminated terms */
+    char *blob;
+
+    /* The memory block; either malloc'ed or mapped from file */
+    void *mem;
+    size_t lenmem;
+    int is_mapped;
+};
+
+/* Prototypes */
+uint64_t vocab_mix(uint64_t h);
+uint64_t vocab_hash(uint64_t seed, char *term);
+struct vocab *vocab_freeze(struct dict *index, long flags, int ngrams, int ngrambits, int *dfs);
+struct vocab *vocab_hashed(int hashbits, long ndocs, int *dfs, long flags, int ngrams, int ngrambits,
+    struct dict *exc);
+long vocab_hash_id(int hashbits, char *term, int *sign);
+long vocab_ngram_id(long base, int ngrambits, long *ids, int n, int *sign);
+long vocab_search(struct vocab *v, char *term);
+int vocab_tokenb(struct vocab *v, struct stemmer *s, long *id, int *sign, int indexbuf, char *buffer);
+int vocab_save(struct vocab *v, char *path);
+struct vocab *vocab_load(char *path);
+void vocab_destroy(struct vocab *v);
+
+#endif